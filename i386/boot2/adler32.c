@@ -0,0 +1,98 @@
+/*
+ *
+ * adler32.c
+ *
+ * The Adler-32 checksum functions used by boot.c and drivers.c (moved here so
+ * that they can also be built, and benchmarked, on the host).
+ *
+ */
+
+#include <libkern/OSByteOrder.h>
+
+#include "boot.h"
+
+
+//==============================================================================
+// Checksum of the prelinked kernel key in boot() (returned in big endian order).
+
+unsigned long Adler32(unsigned char *buf, long len)
+{
+	#define BASE 65521L // largest prime smaller than 65536
+	#define NMAX 5000
+	// NMAX (was 5521) the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1
+	
+	#define DO1(buf, i)  {s1 += buf[i]; s2 += s1;}
+	#define DO2(buf, i)  DO1(buf, i); DO1(buf, i + 1);
+	#define DO4(buf, i)  DO2(buf, i); DO2(buf, i + 2);
+	#define DO8(buf, i)  DO4(buf, i); DO4(buf, i + 4);
+	#define DO16(buf)   DO8(buf, 0); DO8(buf, 8);
+
+	int k;
+
+	unsigned long s1 = 1;	// adler & 0xffff;
+	unsigned long s2 = 0;	// (adler >> 16) & 0xffff;
+	unsigned long result;
+
+	
+	while (len > 0)
+	{
+		k = len < NMAX ? len : NMAX;
+		len -= k;
+
+		while (k >= 16)
+		{
+			DO16(buf);
+			buf += 16;
+			k -= 16;
+		}
+
+		if (k != 0)
+		{
+			do
+			{
+				s1 += *buf++;
+				s2 += s1;
+			} while (--k);
+		}
+
+		s1 %= BASE;
+		s2 %= BASE;
+	}
+
+	result = (s2 << 16) | s1;
+
+	return OSSwapHostToBigInt32(result);
+}
+
+
+//==============================================================================
+// Checksum of compressed kernelcaches and mkext packages in drivers.c (returned
+// in host byte order).
+
+unsigned long localAdler32(unsigned char * buffer, long length)
+{
+    long          cnt;
+    unsigned long result, lowHalf, highHalf;
+    
+    lowHalf  = 1;
+    highHalf = 0;
+  
+	for (cnt = 0; cnt < length; cnt++)
+    {
+        if ((cnt % 5000) == 0)
+        {
+            lowHalf  %= 65521L;
+            highHalf %= 65521L;
+        }
+    
+        lowHalf  += buffer[cnt];
+        highHalf += lowHalf;
+    }
+
+	lowHalf  %= 65521L;
+	highHalf %= 65521L;
+  
+	result = (highHalf << 16) | lowHalf;
+  
+	return result;
+}
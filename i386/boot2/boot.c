@@ -57,64 +57,13 @@
 #include "bootstruct.h"
 #include "sl.h"
 #include "libsa.h"
+#include "kernel_patcher.h"
 
 #if DISABLE_LEGACY_XHCI
 	#include "pci.h"
 	#include "xhci.h"
 #endif
 
-//==============================================================================
-// Local adler32 function.
-
-unsigned long Adler32(unsigned char *buf, long len)
-{
-	#define BASE 65521L // largest prime smaller than 65536
-	#define NMAX 5000
-	// NMAX (was 5521) the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1
-	
-	#define DO1(buf, i)  {s1 += buf[i]; s2 += s1;}
-	#define DO2(buf, i)  DO1(buf, i); DO1(buf, i + 1);
-	#define DO4(buf, i)  DO2(buf, i); DO2(buf, i + 2);
-	#define DO8(buf, i)  DO4(buf, i); DO4(buf, i + 4);
-	#define DO16(buf)   DO8(buf, 0); DO8(buf, 8);
-
-	int k;
-
-	unsigned long s1 = 1;	// adler & 0xffff;
-	unsigned long s2 = 0;	// (adler >> 16) & 0xffff;
-	unsigned long result;
-
-	
-	while (len > 0)
-	{
-		k = len < NMAX ? len : NMAX;
-		len -= k;
-
-		while (k >= 16)
-		{
-			DO16(buf);
-			buf += 16;
-			k -= 16;
-		}
-
-		if (k != 0)
-		{
-			do
-			{
-				s1 += *buf++;
-				s2 += s1;
-			} while (--k);
-		}
-
-		s1 %= BASE;
-		s2 %= BASE;
-	}
-
-	result = (s2 << 16) | s1;
-
-	return OSSwapHostToBigInt32(result);
-}
-
 
 //==============================================================================
 
@@ -154,7 +103,13 @@ static void mallocError(char *addr, size_t size)
 void boot(int biosdev)
 {
 	zeroBSS();
+
+#if DYNAMIC_MEMORY_LAYOUT
+	// Small bootstrap heap, until planMemoryLayout() moves it to the zalloc area.
+	mallocInit((char *)BOOTSTRUCT_ADDR, BOOTSTRUCT_LEN, 0, mallocError);
+#else
 	mallocInit(0, 0, 0, mallocError);
+#endif
 
 #if MUST_ENABLE_A20
 	// Enable A20 gate before accessing memory above 1 MB.
@@ -190,8 +145,14 @@ void boot(int biosdev)
 
 	long flags, cachetime;
 
+	BOOT_PHASE(kBootPhaseInitPlatform);
+
 	initPlatform(biosdev);
 
+#if DYNAMIC_MEMORY_LAYOUT
+	fileLoadBuffer = (void *)kLoadAddr;	// Moved by planMemoryLayout().
+#endif
+
 #if DEBUG_BOOT
 	/*
 	 * In DEBUG mode we don't switch to graphics mode and do not show the Apple boot logo.
@@ -258,6 +219,13 @@ void boot(int biosdev)
 	}
 #endif // #if STARTUP_DISK_SUPPORT
 
+#if BOOT_IO_TRACE
+	// Read the sectors of the previous boot (saved in /Extra/BootIOTrace.bin) in one go.
+	prefetchBootIOTrace();
+#endif
+
+	BOOT_PHASE(kBootPhaseLoadCABootPlist);
+
 	if (loadCABootPlist() == EFI_SUCCESS)
 	{
 		_BOOT_DEBUG_DUMP("com.apple.Boot.plist located.\n");
@@ -426,6 +394,11 @@ void boot(int biosdev)
 
 	updateEFITree(rootUUID);
 
+#if LOAD_EXTRA_KERNEL_PATCHES
+	// Must be done before the kernel is loaded (uses the same load buffer).
+	loadKernelPatches();
+#endif
+
 	if (haveCABootPlist) // Check boolean before doing more time consuming tasks.
 	{
 #if PRELINKED_KERNEL_SUPPORT
@@ -710,6 +683,8 @@ void boot(int biosdev)
 
 		_BOOT_DEBUG_DUMP("About to load: %s\n", bootFile);
 
+		BOOT_PHASE(kBootPhaseLoadKernel);
+
 		retStatus = LoadThinFatFile(bootFile, &fileLoadBuffer);
 
 #if SUPPORT_32BIT_MODE
@@ -740,7 +715,9 @@ void boot(int biosdev)
 			bootArgs->kaddr = bootArgs->ksize = 0;
 			
 			_BOOT_DEBUG_DUMP("execKernel-1\n");
-			
+
+			BOOT_PHASE(kBootPhaseDecodeKernel);
+
 			if (decodeKernel(fileLoadBuffer, &kernelEntry, (char **) &bootArgs->kaddr, (int *)&bootArgs->ksize) != 0)
 			{
 				stop("DecodeKernel() failed!");
@@ -759,6 +736,8 @@ void boot(int biosdev)
 			{
 				_BOOT_DEBUG_DUMP("Calling loadDrivers()\n");
 
+				BOOT_PHASE(kBootPhaseLoadDrivers);
+
 				// Yes. Load boot drivers from root path.
 				loadDrivers("/");
 			}
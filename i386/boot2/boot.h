@@ -100,6 +100,13 @@ extern char bootPrompt[];
 #define PLATFORM_NAME_LEN 64
 #define ROOT_PATH_LEN 256
 
+/*
+ * adler32.c
+ */
+
+extern unsigned long Adler32(unsigned char *buf, long len);
+extern unsigned long localAdler32(unsigned char * buffer, long length);
+
 /*
  * bootlogo.c
  */
@@ -44,6 +44,9 @@
 
 #define MAX_KEXT_PATH_LENGTH	256
 
+// Masked vmaddr of __TEXT (fileoff 0) in x86_64 kernels (0xffffff8000200000).
+#define KERNEL_IMAGE_ADDR		0x00200000
+
 int gKextLoadStatus = 0; // Used to keep track of MKext loads.
 
 typedef struct Module
@@ -93,8 +96,6 @@ enum
 // END_DUPLICATED_BLOCK
 
 // Private functions.
-static unsigned long localAdler32(unsigned char * buffer, long length);
-
 #if (MAKE_TARGET_OS == SNOW_LEOPARD)
 	static int loadMultiKext(char *fileSpec);
 #endif
@@ -109,42 +110,14 @@ static long matchLibraries(void);
 	static void			ThinFatFile(void **loadAddrP, unsigned long *lengthP);
 #endif
 
-static long parseXML(char *buffer, ModulePtr *module, TagPtr *personalities);
+static long parseXML(char *buffer, long length, ModulePtr *module, TagPtr *personalities);
 static long initDriverSupport(void);
 
 static ModulePtr gModuleHead, gModuleTail;
-static TagPtr    gPersonalityHead, gPersonalityTail;
-
-
-//==============================================================================
-
-static unsigned long localAdler32(unsigned char * buffer, long length)
-{
-    long          cnt;
-    unsigned long result, lowHalf, highHalf;
-    
-    lowHalf  = 1;
-    highHalf = 0;
-  
-	for (cnt = 0; cnt < length; cnt++)
-    {
-        if ((cnt % 5000) == 0)
-        {
-            lowHalf  %= 65521L;
-            highHalf %= 65521L;
-        }
-    
-        lowHalf  += buffer[cnt];
-        highHalf += lowHalf;
-    }
 
-	lowHalf  %= 65521L;
-	highHalf %= 65521L;
-  
-	result = (highHalf << 16) | lowHalf;
-  
-	return result;
-}
+// Arena for the tags of the plist that is being parsed (see loadPlist).
+static arena_t * gPlistArena = NULL;
+static TagPtr    gPersonalityHead, gPersonalityTail;
 
 
 //==============================================================================
@@ -236,6 +209,9 @@ long loadDrivers(char * dirSpec)
 	matchLibraries();
 	loadMatchedModules();
 
+#if DEBUG_DRIVERS
+	XMLPrintSymbolStats();
+#endif
 	_DRIVERS_DEBUG_SLEEP(15);
 
 	return EFI_SUCCESS;
@@ -483,10 +459,26 @@ static int loadPlist(char * targetFolder, bool isBundleType2)
 				if (plistBuffer)
 				{
 					_DRIVERS_DEBUG_DUMP("1");
-					strlcpy(plistBuffer, (char *)kLoadAddr, plistLength);
+					// Binary plists can contain zero bytes (strlcpy would stop there).
+					memcpy(plistBuffer, (char *)kLoadAddr, plistLength - 1);
+					plistBuffer[plistLength - 1] = '\0';
+
+					/*
+					 * Parse the plist into its own arena. Plists that we drop are
+					 * released with a single arena_reset() and the arena reused.
+					 */
+					if (gPlistArena == NULL)
+					{
+						// Tags and strings take about twice the size of the plist.
+						gPlistArena = arena_create(plistLength * 2);
+					}
+
+					XMLSetArena(gPlistArena);
+					long parseResult = parseXML(plistBuffer, plistLength - 1, &module, &personalities);
+					XMLSetArena(NULL);
 
 					// parseXML returns 0 on success so we check that here.
-					if (parseXML(plistBuffer, &module, &personalities) == 0)
+					if (parseResult == 0)
 					{
 						_DRIVERS_DEBUG_DUMP("2");
 						// Allocate memory for the driver path and the plist.
@@ -502,7 +494,8 @@ static int loadPlist(char * targetFolder, bool isBundleType2)
 							tmpBundlePath = tmpExecutablePath = 0;
 
 							// Add the plist to the module.
-							strlcpy(module->plistAddr, (char *)kLoadAddr, plistLength);
+							memcpy(module->plistAddr, (char *)kLoadAddr, plistLength - 1);
+							module->plistAddr[plistLength - 1] = '\0';
 							module->plistLength = plistLength;
 
 							// Add the module to the end of the module list.
@@ -540,10 +533,19 @@ static int loadPlist(char * targetFolder, bool isBundleType2)
 
 							result = 0;
 
+							// The tags of the module live in this arena, so it is left allocated
+							// (never reset or freed) and the next plist gets a new arena.
+							gPlistArena = NULL;
+
 							_DRIVERS_DEBUG_DUMP(".");
 						}
 					}
 
+					if (gPlistArena)
+					{
+						arena_reset(gPlistArena);
+					}
+
 					free(plistBuffer);
 				}
 			}
@@ -635,7 +637,7 @@ static long loadMatchedModules(void)
                 driver->bundlePathLength = module->bundlePathLength;
 
                 // Save the plist, module and bundle.
-                strcpy(driver->plistAddr, module->plistAddr);
+                memcpy(driver->plistAddr, module->plistAddr, module->plistLength);
 
 				if (length != 0)
 				{
@@ -800,12 +802,19 @@ static bool isLoadableInSafeBoot(char * OSBundleRequired)
 
 //==============================================================================
 
-static long parseXML(char * buffer, ModulePtr * module, TagPtr * personalities)
+static long parseXML(char * buffer, long length, ModulePtr * module, TagPtr * personalities)
 {
-	long       length, pos = 0;
+	long       pos = 0;
 	TagPtr     moduleDict, required;
 	ModulePtr  tmpModule;
-  
+
+#if BINARY_PLIST_SUPPORT
+	if (XMLIsBinaryPlist(buffer, length))
+	{
+		length = XMLParseBinaryPlist(buffer, length, &moduleDict);
+	}
+	else
+#endif
 	while (1)
 	{
 		length = XMLParseNextTag(buffer + pos, &moduleDict);
@@ -886,8 +895,7 @@ static long parseXML(char * buffer, ModulePtr * module, TagPtr * personalities)
 		return -2;
 	}
 
-	// tmpModule = (ModulePtr)malloc(sizeof(Module));
-	tmpModule = malloc(sizeof(Module));
+	tmpModule = calloc(1, sizeof(Module));
 
 	if (tmpModule == 0)
 	{
@@ -961,15 +969,25 @@ long decodeKernel(void *fileLoadBuffer, entry_t *rentry, char **raddr, int *rsiz
 #endif
 		compressedSize = OSSwapBigToHostInt32(kernel_header->compressedSize);
 		uncompressedSize = OSSwapBigToHostInt32(kernel_header->uncompressedSize);
-		fileLoadBuffer = malloc(uncompressedSize);
+
+		/*
+		 * Decompress straight into the kernel area, at the address where the
+		 * image ends up when its file offsets match the (masked) vmaddrs, so
+		 * that DecodeMachO() doesn't have to copy the segments a second time.
+		 */
+		if ((KERNEL_IMAGE_ADDR + uncompressedSize) <= (KERNEL_ADDR + KERNEL_LEN))
+		{
+			fileLoadBuffer = (void *)KERNEL_IMAGE_ADDR;
+		}
+		else
+		{
+			fileLoadBuffer = malloc(uncompressedSize);
+		}
 
 #if ((MAKE_TARGET_OS & YOSEMITE) == YOSEMITE) // Yosemite and El Capitan
 		if (kernel_header->compressType == OSSwapBigToHostConstInt32('lzvn'))
 		{
-			void *tmpBuffer = malloc(uncompressedSize);
-			size = lzvn_decode(tmpBuffer, uncompressedSize, &kernel_header->data[0], compressedSize);
-			memcpy(fileLoadBuffer, tmpBuffer, uncompressedSize);
-			free(tmpBuffer);
+			size = lzvn_decode(fileLoadBuffer, uncompressedSize, &kernel_header->data[0], compressedSize);
 		} else
 #endif
 		if (kernel_header->compressType == OSSwapBigToHostConstInt32('lzss'))
@@ -988,6 +1006,14 @@ long decodeKernel(void *fileLoadBuffer, entry_t *rentry, char **raddr, int *rsiz
 			printf("Adler mismatch, is 0x%x but 0x%x is expected\n", OSSwapBigToHostInt32(kernel_header->adler32), localAdler32(fileLoadBuffer, uncompressedSize));
 			return -1;
 		}
+
+		// Move the image out of the way when the layout doesn't allow in place use.
+		if (fileLoadBuffer == (void *)KERNEL_IMAGE_ADDR && !isMachOInPlace(fileLoadBuffer, uncompressedSize))
+		{
+			void * buffer = malloc(uncompressedSize);
+			memcpy(buffer, fileLoadBuffer, uncompressedSize);
+			fileLoadBuffer = buffer;
+		}
 	}
 
 	ret = ThinFatFile(&fileLoadBuffer, &len);
@@ -145,7 +145,7 @@
 												// falls back to: /Extra/ACPI/[XXXX].aml when model specific data is not available.
 #endif
 
-#define AUTOMATIC_SSDT_PR_CREATION			0	// Set to 0 by default (support for Sandy Bridge only).
+#define AUTOMATIC_SSDT_PR_CREATION			0	// Set to 0 by default (written for Sandy Bridge, supports any number of threads).
 												//
 												// This injects a custom SSDT (in configure mode) with:
 												//
@@ -155,21 +155,14 @@
 												// Use 4 to inject: Device (SBUS) {...} which is required for Power Management.
 												// Use 5 to inject: P/C-State definition blocks plus the former (Device SBUS).
 												// Use 7 to inject: All of the above.
+												// Add 8 to inject: Method (_PSS) and Method (_CST) for each processor (with 1).
 												// 
 												// Notes:	Device SBUS can only be injected when it isn't part of other ACPI tables!
 												//			This feature should only be used once, to extract the SSDT_PR from ioreg
 												//			and use it as STATIC_SSDT_PR_TABLE_DATA in RevoBoot/i386/config/ACPI/data.h
 
 
-#if (AUTOMATIC_SSDT_PR_CREATION == 1 && STATIC_SSDT_PR_TABLE_INJECTION == 0)
-	#define MAX_NUMBER_OF_P_STATES			22	// The i5-2500K need 18 for the base-range (1600-3300) plus 4 for the Turbo modes.
-												// The i7-2600K need 19 for the base-range (1600-3400) plus 4 for the Turbo modes.
-												// The i7-2700K need 20 for the base-range (1600-3500) plus 4 for the Turbo modes.
-												// The i7-3770K need 20 for the base-range (1600-3500) plus 4 for the Turbo modes.
-												// Low power (mobility) processors might need an extended range!
-												//
-												// Note: AICPUPM wants a P-State for each 100 MHz bank or it will fail (see note below).
-
+#if ((AUTOMATIC_SSDT_PR_CREATION & 1) && STATIC_SSDT_PR_TABLE_INJECTION == 0)
 	#define DROP_FACTORY_SSDT_TABLES		1	// Set to 1 by default (this setting may be required on some boards).
 												//
 												// Note: Do not change this setting (must drop SSDT tables).
@@ -196,6 +189,21 @@
 												//
 												// Note: Don't forget to set PATCH_ACPI_TABLE_DATA to 1.
 
+#define PATCH_AML_RENAMES					0	// Set to 0 by default. Use 1 to apply the AML_RENAME_RULES (below) to the DSDT
+												// and SSDT tables, which often saves you from having to use a modified DSDT.
+												//
+												// Note: Don't forget to set PATCH_ACPI_TABLE_DATA to 1.
+
+#if PATCH_AML_RENAMES
+	#define AML_RENAME_RULES \
+		AML_RENAME("EC0_", "EC__"), \
+		AML_RENAME("HDAS", "HDEF"), \
+		AML_RENAME("GFX0", "IGPU")				// Find and replace pattern (may contain "\xNN" bytes) must be of the same length.
+												//
+												// Note: Renaming a method like _OSI to XOSI breaks every call to it, unless
+												//		 you also inject an SSDT (/Extra/ACPI/SSDT-1.aml) that defines XOSI.
+#endif
+
 #define	APPLE_STYLE_ACPI					0	// Set to 0 by default. Use 1 to change the OEMID's to Mac likes.
 												//
 												// Note:	Don't forget to set PATCH_ACPI_TABLE_DATA to 1 and keep in mind that this can 
@@ -214,6 +222,12 @@
 
 #define SAFE_MALLOC							0	// Set to 0 by default. Change this to 1 when booting halts with a memory allocation error.
 
+#define DEBUG_MALLOC_POISON					0	// Set to 0 by default. Change this to 1 to fill new malloc blocks with 0xA5 (catches code that
+												// depends on zeroed memory without using calloc).
+
+#define DYNAMIC_MEMORY_LAYOUT				0	// Set to 0 by default. Change this to 1 to size the kernel, zalloc and file load areas from the
+												// E820 memory map (instead of the fixed 128/256/95 MB windows in libsa/memory.h).
+
 #define RECOVERY_HD_SUPPORT					0	// Set to 0 by default. Change this to 1 to make RevoBoot search for the 'Recovery HD'
 												// partition and, when available, boot from it.
 #if (RECOVERY_HD_SUPPORT == 1 && PRE_LINKED_KERNEL_SUPPORT == 0)
@@ -231,6 +245,9 @@
 
 #define DISABLE_LEGACY_XHCI					0	// Set to 0 by default. Change this to 1 when you need to disable legacy XHCI.
 
+#define BOOT_PROFILER						0	// Set to 0 by default. Change this to 1 to record the duration of the boot phases (exported
+												// via bootArgs->performanceDataStart and the boot-phases property of /RevoEFI).
+
 #define DEBUG_BOOT							0	// Set to 0 by default. Change this to 1 when things don't seem to work for you.
 
 
@@ -301,6 +318,12 @@
 
 #define APPLE_RAID_SUPPORT					0	// Set to 0 by default. Change this to 1 for Apple Software RAID support.
 
+#define IO_STATISTICS						0	// Set to 0 by default. Change this to 1 to count BIOS calls, sectors, cache hits and B-tree
+												// node reads per boot phase (exported via the io-stats property of /RevoEFI).
+
+#define BOOT_IO_TRACE						0	// Set to 0 by default. Change this to 1 to record the disk reads of each boot (exported via the
+												// boot-io-trace property of /RevoEFI) and to prefetch the ones saved in /Extra/BootIOTrace.bin
+
 #define DEBUG_DISK							0	// Set to 0 by default. Change it to 1 when things don't seem to work for you.
 
 
@@ -377,6 +400,9 @@
 	#define INSTALL_ESD_SUPPORT				1	// This setting is mandatory for RECOVERY_HD_SUPPORT
 #endif
 
+#define BINARY_PLIST_SUPPORT				0	// Set to 0 by default. Change this to 1 when you converted com.apple.Boot.plist and/or
+												// other plists to the binary (bplist00) format i.e. with: plutil -convert binary1
+
 //-------------------------------------------------------------- SMBIOS.C ------------------------------------------------------------------
 
 
@@ -440,6 +466,8 @@
 #define READ_STARTUP_EXTENSIONS_TARGET_UINT64	0xe805eb00000025e8ULL // e825000000eb05e8 revered in HexEdit
 #define READ_STARTUP_EXTENSIONS_PATCH_UINT64	0xe8909000000025e8ULL
 
+#define LOAD_EXTRA_KERNEL_PATCHES				0	// Set to 0 by default. Change this to 1 when you want to use: /Extra/KernelPatches.plist
+
 
 //-------------------------------------------------------------- PLATFORM.C ----------------------------------------------------------------
 
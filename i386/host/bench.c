@@ -0,0 +1,757 @@
+/*
+ *
+ * bench.c
+ *
+ * Micro benchmark for the decompression and checksum functions of the booter:
+ * lzvn_decode(), decompressLZSS(), Adler32(), localAdler32() and crc32(). The
+ * corpora are the packed Apple logo of showBootLogo(), synthetic worst cases
+ * and the (compressed) kernelcaches given on the command line. All output is
+ * checked against the (simple) reference implementations in this file.
+ *
+ * Usage: bench [-n runs] [-w baseline] [-b baseline [-t percent]] [kernelcache ...]
+ *
+ * -w saves the throughput of each case, -b compares against a saved baseline
+ * and fails when a case is more than 'percent' (default 10) slower.
+ *
+ */
+
+#include <libkern/OSByteOrder.h>
+#include <mach-o/fat.h>
+
+#include "boot.h"
+
+#pragma GCC diagnostic ignored "-Wunused-variable"	// The logo colour tables.
+#include "bootlogo.h"
+#pragma GCC diagnostic warning "-Wunused-variable"
+
+#include "host.h"
+
+#define MAX_CASES			64
+#define MAX_NAME_LENGTH		48
+
+#define SYNTHETIC_SIZE		(8 * 1024 * 1024)
+#define PADDING				64			// lzvn_decode() reads and writes eight bytes at a time.
+
+#define LZSS_N				4096
+#define LZSS_F				18
+
+
+enum
+{
+	kLZVN = 0,
+	kLZSS,
+	kAdler32,
+	kLocalAdler32,
+	kCRC32
+};
+
+static const char * gFunctionNames[] =
+{
+	"lzvn_decode",
+	"decompressLZSS",
+	"Adler32",
+	"localAdler32",
+	"crc32"
+};
+
+
+typedef struct BenchCase
+{
+	char				name[MAX_NAME_LENGTH];
+	int					function;
+	bool				passed;
+	unsigned long		bytes;				// Decompressed size or checksummed length.
+	unsigned long long	nanoseconds;		// Fastest run.
+	unsigned long long	cycles;
+} BenchCase;
+
+
+static BenchCase	gCases[MAX_CASES];
+static int			gCaseCount = 0;
+static int			gRuns = 5;
+
+static uint32_t		gRandomState = 0x2545F491;
+
+
+//==============================================================================
+
+static uint8_t nextRandom(void)
+{
+	gRandomState ^= (gRandomState << 13);
+	gRandomState ^= (gRandomState >> 17);
+	gRandomState ^= (gRandomState << 5);
+
+	return (uint8_t)gRandomState;
+}
+
+
+//==============================================================================
+// Reference LZVN decoder (one opcode at a time, as documented in lzfse).
+// Returns the decompressed size, or 0 for invalid data.
+
+static unsigned long referenceLZVN(uint8_t * dst, unsigned long dstSize, const uint8_t * src, unsigned long srcSize)
+{
+	unsigned long i, in = 0, out = 0, L, M, D = 0, opcodeLength;
+
+	while (in < srcSize)
+	{
+		uint8_t opcode = src[in];
+
+		L = M = 0;
+		opcodeLength = 1;
+
+		if (opcode == 0x06)									// End of stream.
+		{
+			return out;
+		}
+		else if (opcode == 0x0E || opcode == 0x16)			// Nop.
+		{
+			in++;
+			continue;
+		}
+		else if (opcode >= 0xE0)
+		{
+			if (opcode == 0xE0)								// Large literal.
+			{
+				L = src[in + 1] + 16;
+				opcodeLength = 2;
+			}
+			else if (opcode < 0xF0)							// Small literal.
+			{
+				L = (opcode & 0x0F);
+			}
+			else if (opcode == 0xF0)						// Large match (previous distance).
+			{
+				M = src[in + 1] + 16;
+				opcodeLength = 2;
+			}
+			else											// Small match (previous distance).
+			{
+				M = (opcode & 0x0F);
+			}
+		}
+		else if ((opcode & 0xF0) == 0x70 || (opcode & 0xF0) == 0xD0)
+		{
+			return 0;										// Undefined.
+		}
+		else if ((opcode & 0xE0) == 0xA0)					// Medium distance.
+		{
+			L = ((opcode >> 3) & 3);
+			M = ((((opcode & 7) << 2) | (src[in + 1] & 3)) + 3);
+			D = ((src[in + 1] >> 2) | (src[in + 2] << 6));
+			opcodeLength = 3;
+		}
+		else
+		{
+			L = (opcode >> 6);
+			M = (((opcode >> 3) & 7) + 3);
+
+			switch (opcode & 7)
+			{
+				case 6:										// Previous distance.
+					if (opcode < 0x40)
+					{
+						return 0;							// Undefined.
+					}
+					break;
+
+				case 7:										// Large distance.
+					D = (src[in + 1] | (src[in + 2] << 8));
+					opcodeLength = 3;
+					break;
+
+				default:									// Small distance.
+					D = (((opcode & 7) << 8) | src[in + 1]);
+					opcodeLength = 2;
+			}
+		}
+
+		if ((in + opcodeLength + L) > srcSize || (out + L + M) > dstSize)
+		{
+			return 0;
+		}
+
+		for (i = 0; i < L; i++)
+		{
+			dst[out++] = src[in + opcodeLength + i];
+		}
+
+		if (M && (D == 0 || D > out))
+		{
+			return 0;
+		}
+
+		for (i = 0; i < M; i++, out++)
+		{
+			dst[out] = dst[out - D];
+		}
+
+		in += (opcodeLength + L);
+	}
+
+	return 0;												// No end of stream marker.
+}
+
+
+//==============================================================================
+// Reference LZSS decoder (Okumura). Returns the decompressed size.
+
+static unsigned long referenceLZSS(uint8_t * dst, unsigned long dstSize, const uint8_t * src, unsigned long srcSize)
+{
+	uint8_t ring[LZSS_N];
+	unsigned long in = 0, out = 0, flags = 0, bits = 0;
+	int k, r = (LZSS_N - LZSS_F);
+
+	memset(ring, ' ', sizeof(ring));
+
+	while (in < srcSize)
+	{
+		if (bits == 0)
+		{
+			flags = src[in++];
+			bits = 8;
+			continue;
+		}
+
+		if (flags & 1)
+		{
+			if (out >= dstSize)
+			{
+				break;
+			}
+
+			dst[out++] = ring[r++ & (LZSS_N - 1)] = src[in++];
+		}
+		else
+		{
+			if ((in + 2) > srcSize)
+			{
+				break;
+			}
+
+			int position = (src[in] | ((src[in + 1] & 0xF0) << 4));
+			int length = ((src[in + 1] & 0x0F) + 3);
+
+			in += 2;
+
+			for (k = 0; k < length && out < dstSize; k++)
+			{
+				dst[out++] = ring[r++ & (LZSS_N - 1)] = ring[(position + k) & (LZSS_N - 1)];
+			}
+		}
+
+		r &= (LZSS_N - 1);
+		flags >>= 1;
+		bits--;
+	}
+
+	return out;
+}
+
+
+//==============================================================================
+// Reference Adler-32 (modulo after every byte).
+
+static uint32_t referenceAdler32(const uint8_t * buffer, unsigned long length)
+{
+	uint32_t a = 1, b = 0;
+
+	while (length--)
+	{
+		a = (a + *buffer++) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	return (b << 16) | a;
+}
+
+
+//==============================================================================
+// Reference CRC-32 (bitwise, reflected polynomial 0xEDB88320).
+
+static uint32_t referenceCRC32(const uint8_t * buffer, unsigned long length)
+{
+	int bit;
+	uint32_t crc = ~0U;
+
+	while (length--)
+	{
+		crc ^= *buffer++;
+
+		for (bit = 0; bit < 8; bit++)
+		{
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+		}
+	}
+
+	return ~crc;
+}
+
+
+//==============================================================================
+// Runs one case gRuns times and keeps the fastest run. Decompressed data is
+// compared with 'expected', checksums with the reference implementations.
+
+static void runCase(const char * name, int function, uint8_t * input, unsigned long inputSize, const uint8_t * expected, unsigned long expectedSize)
+{
+	int run;
+	uint32_t checksum = 0;
+	unsigned long size = 0;
+	unsigned long long start, cycles;
+
+	if (gCaseCount >= MAX_CASES)
+	{
+		return;
+	}
+
+	BenchCase * benchCase = &gCases[gCaseCount++];
+
+	sprintf(benchCase->name, "%s/%.32s", gFunctionNames[function], name);
+
+	benchCase->function = function;
+	benchCase->bytes = (function <= kLZSS) ? expectedSize : inputSize;
+	benchCase->nanoseconds = ~0ULL;
+
+	uint8_t * output = (function <= kLZSS) ? calloc(1, expectedSize + PADDING) : NULL;
+
+	for (run = 0; run < gRuns; run++)
+	{
+		start = hostNanoseconds();
+		cycles = hostCycles();
+
+		switch (function)
+		{
+			case kLZVN:			size = lzvn_decode(output, expectedSize, input, inputSize);		break;
+			case kLZSS:			size = decompressLZSS(output, input, inputSize);					break;
+			case kAdler32:		checksum = Adler32(input, inputSize);								break;
+			case kLocalAdler32:	checksum = localAdler32(input, inputSize);							break;
+			case kCRC32:		checksum = crc32(0, input, inputSize);								break;
+		}
+
+		cycles = (hostCycles() - cycles);
+		start = (hostNanoseconds() - start);
+
+		if (start < benchCase->nanoseconds)
+		{
+			benchCase->nanoseconds = start;
+			benchCase->cycles = cycles;
+		}
+	}
+
+	switch (function)
+	{
+		case kLZVN:
+		case kLZSS:
+			benchCase->passed = (size == expectedSize && memcmp(output, expected, expectedSize) == 0);
+			break;
+
+		case kAdler32:
+			benchCase->passed = (checksum == OSSwapHostToBigInt32(referenceAdler32(input, inputSize)));
+			break;
+
+		case kLocalAdler32:
+			benchCase->passed = (checksum == referenceAdler32(input, inputSize));
+			break;
+
+		case kCRC32:
+			benchCase->passed = (checksum == referenceCRC32(input, inputSize));
+			break;
+	}
+
+	free(output);
+}
+
+
+//==============================================================================
+// Adds the checksum cases for a buffer.
+
+static void runChecksumCases(const char * name, uint8_t * buffer, unsigned long size)
+{
+	runCase(name, kAdler32, buffer, size, NULL, 0);
+	runCase(name, kLocalAdler32, buffer, size, NULL, 0);
+	runCase(name, kCRC32, buffer, size, NULL, 0);
+}
+
+
+//==============================================================================
+// Decodes 'data' with the reference decoder and adds a case for it (and the
+// checksums of the decompressed data). Returns false for invalid data.
+
+static bool runDecoderCase(const char * name, int function, uint8_t * data, unsigned long size, unsigned long expectedSize, uint32_t * adler32)
+{
+	uint8_t * expected = calloc(1, expectedSize + PADDING);
+
+	unsigned long length = (function == kLZVN) ? referenceLZVN(expected, expectedSize, data, size)
+											   : referenceLZSS(expected, expectedSize, data, size);
+
+	if (length != expectedSize || (adler32 && *adler32 != referenceAdler32(expected, expectedSize)))
+	{
+		error("bench: %s is not valid %s data.\n", name, (function == kLZVN) ? "LZVN" : "LZSS");
+		free(expected);
+
+		return false;
+	}
+
+	runCase(name, function, data, size, expected, expectedSize);
+
+	if (adler32)
+	{
+		runChecksumCases(name, expected, expectedSize);
+	}
+
+	free(expected);
+
+	return true;
+}
+
+
+//==============================================================================
+
+static void runLogoCases(void)
+{
+#if (((MAKE_TARGET_OS & YOSEMITE) == YOSEMITE) && (BLACKMODE == 1))
+	uint8_t * logoData = AppleLogoBlackPacked;
+	unsigned long compressedSize = sizeof(AppleLogoBlackPacked);
+#else
+	uint8_t * logoData = AppleLogoPacked;
+	unsigned long compressedSize = sizeof(AppleLogoPacked);
+#endif
+	uint8_t * data = calloc(1, compressedSize + PADDING);
+
+	memcpy(data, logoData, compressedSize);
+
+	runDecoderCase("logo", kLZVN, data, compressedSize, (APPLE_LOGO_WIDTH * APPLE_LOGO_HEIGHT), NULL);
+
+	free(data);
+}
+
+
+//==============================================================================
+// Synthetic worst cases: incompressible (literal only) streams and streams of
+// the shortest matches, plus checksums over random and all 0xFF data.
+
+static void runSyntheticCases(void)
+{
+	unsigned long i, j, count, size;
+
+	uint8_t * data = calloc(1, (SYNTHETIC_SIZE * 2) + PADDING);
+
+	// LZSS, only literals (a flag byte for every eight bytes).
+	for (size = 0, count = 0; count < SYNTHETIC_SIZE; count += 8)
+	{
+		data[size++] = 0xFF;
+
+		for (j = 0; j < 8; j++)
+		{
+			data[size++] = nextRandom();
+		}
+	}
+
+	runDecoderCase("literals", kLZSS, data, size, count, NULL);
+
+	// LZSS, only 18 byte matches (from the part of the ring buffer that is initialized).
+	for (size = 0, count = 0; count < SYNTHETIC_SIZE; count += (8 * LZSS_F))
+	{
+		data[size++] = 0x00;
+
+		for (j = 0; j < 8; j++)
+		{
+			int position = ((nextRandom() << 4) | (nextRandom() & 0x0F)) % (LZSS_N - (2 * LZSS_F));
+
+			data[size++] = (position & 0xFF);
+			data[size++] = (((position >> 4) & 0xF0) | 0x0F);
+		}
+	}
+
+	runDecoderCase("matches", kLZSS, data, size, count, NULL);
+
+	// LZVN, only (271 byte) large literals.
+	for (size = 0, count = 0; (count + 271) <= SYNTHETIC_SIZE; count += 271)
+	{
+		data[size++] = 0xE0;
+		data[size++] = 0xFF;
+
+		for (j = 0; j < 271; j++)
+		{
+			data[size++] = nextRandom();
+		}
+	}
+
+	bzero(&data[size], 8);
+	data[size] = 0x06;
+
+	runDecoderCase("literals", kLZVN, data, (size + 8), count, NULL);
+
+	// LZVN, one small literal followed by only three byte, small distance matches.
+	data[0] = 0xE1;
+	data[1] = nextRandom();
+
+	for (size = 2, count = 1; (count + 3) <= SYNTHETIC_SIZE; count += 3)
+	{
+		unsigned long distance = ((nextRandom() % 255) + 1);
+
+		data[size++] = 0x00;
+		data[size++] = ((distance > count) ? count : distance);
+	}
+
+	bzero(&data[size], 8);
+	data[size] = 0x06;
+
+	runDecoderCase("matches", kLZVN, data, (size + 8), count, NULL);
+
+	for (i = 0; i < SYNTHETIC_SIZE; i++)
+	{
+		data[i] = nextRandom();
+	}
+
+	runChecksumCases("random", data, SYNTHETIC_SIZE);
+
+	memset(data, 0xFF, SYNTHETIC_SIZE);
+
+	runChecksumCases("0xff", data, SYNTHETIC_SIZE);
+
+	free(data);
+}
+
+
+//==============================================================================
+// Adds the cases for a (fat or thin) compressed kernelcache.
+
+static bool runKernelCacheCases(const char * path)
+{
+	unsigned long i, size, offset = 0;
+	const char * name = path;
+
+	uint8_t * file = hostLoadFile(path, PADDING, &size);
+
+	if (file == NULL)
+	{
+		error("bench: cannot read %s\n", path);
+		return false;
+	}
+
+	for (i = 0; path[i]; i++)
+	{
+		if (path[i] == '/')
+		{
+			name = &path[i + 1];
+		}
+	}
+
+	struct fat_header * fatHeader = (struct fat_header *)file;
+
+	if (size >= sizeof(struct fat_header) && fatHeader->magic == OSSwapHostToBigConstInt32(FAT_MAGIC))
+	{
+		struct fat_arch * fatArch = (struct fat_arch *)(fatHeader + 1);
+
+		for (i = 0; i < OSSwapBigToHostInt32(fatHeader->nfat_arch); i++, fatArch++)
+		{
+			if ((unsigned char *)(fatArch + 1) <= (file + size) && OSSwapBigToHostInt32(fatArch->cputype) == CPU_TYPE_X86_64)
+			{
+				offset = OSSwapBigToHostInt32(fatArch->offset);
+			}
+		}
+	}
+
+	compressed_kernel_header * header = (compressed_kernel_header *)(file + offset);
+
+	bool valid = ((offset + sizeof(compressed_kernel_header)) <= size && header->signature == OSSwapHostToBigConstInt32('comp'));
+
+	if (valid)
+	{
+		uint32_t adler32 = OSSwapBigToHostInt32(header->adler32);
+		unsigned long compressedSize = OSSwapBigToHostInt32(header->compressedSize);
+
+		valid = ((offset + sizeof(compressed_kernel_header) + compressedSize) <= size);
+
+		if (valid && header->compressType == OSSwapHostToBigConstInt32('lzvn'))
+		{
+			valid = runDecoderCase(name, kLZVN, header->data, compressedSize, OSSwapBigToHostInt32(header->uncompressedSize), &adler32);
+		}
+		else if (valid && header->compressType == OSSwapHostToBigConstInt32('lzss'))
+		{
+			valid = runDecoderCase(name, kLZSS, header->data, compressedSize, OSSwapBigToHostInt32(header->uncompressedSize), &adler32);
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+	if (!valid)
+	{
+		error("bench: %s is not a (valid) compressed kernelcache.\n", path);
+	}
+
+	free(file);
+
+	return valid;
+}
+
+
+//==============================================================================
+// Returns the throughput of a case in KB/s.
+
+static unsigned long getThroughput(BenchCase * benchCase)
+{
+	return (unsigned long)(((double)benchCase->bytes * 1000000000 / 1024) / (benchCase->nanoseconds ? benchCase->nanoseconds : 1));
+}
+
+
+//==============================================================================
+// Saves the throughput of all cases ("name KB/s" lines). Returns 0 on success.
+
+static int saveBaseline(const char * path)
+{
+	int i;
+	unsigned long length = 0;
+
+	char * buffer = malloc(MAX_CASES * (MAX_NAME_LENGTH + 24));
+
+	for (i = 0; i < gCaseCount; i++)
+	{
+		length += sprintf(&buffer[length], "%s %lu\n", gCases[i].name, getThroughput(&gCases[i]));
+	}
+
+	int status = hostSaveFile(path, buffer, length);
+
+	free(buffer);
+
+	return status;
+}
+
+
+//==============================================================================
+// Returns the number of cases that are more than 'percent' slower than in the
+// baseline file, or -1 when it cannot be read.
+
+static int checkBaseline(const char * path, unsigned long percent)
+{
+	int i, regressions = 0;
+	unsigned long size, baseline;
+
+	char * line, * end, * buffer = hostLoadFile(path, 1, &size);
+
+	if (buffer == NULL)
+	{
+		return -1;
+	}
+
+	for (line = buffer; *line; line = end)
+	{
+		char * value = line;
+
+		for (end = line; *end && *end != '\n'; end++)
+		{
+			if (*end == ' ')
+			{
+				value = end;
+			}
+		}
+
+		if (*end)
+		{
+			*end++ = '\0';
+		}
+
+		if (value == line)
+		{
+			continue;
+		}
+
+		*value++ = '\0';
+		baseline = strtoul(value, NULL, 10);
+
+		for (i = 0; i < gCaseCount; i++)
+		{
+			if (strcmp(gCases[i].name, line) == 0 && (getThroughput(&gCases[i]) * 100) < (baseline * (100 - percent)))
+			{
+				printf("%s: %lu KB/s is more than %lu%% below the baseline (%lu KB/s).\n", line, getThroughput(&gCases[i]), percent, baseline);
+				regressions++;
+			}
+		}
+	}
+
+	free(buffer);
+
+	return regressions;
+}
+
+
+//==============================================================================
+
+int main(int argc, char * argv[])
+{
+	int i, failures = 0;
+	unsigned long percent = 10;
+	char * baseline = NULL, * saveAs = NULL;
+
+	bool usage = false;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && !usage; i += 2)
+	{
+		char * value = ((i + 1) < argc) ? argv[i + 1] : NULL;
+
+		switch (value ? argv[i][1] : '?')
+		{
+			case 'n': gRuns = atoi(value);		break;
+			case 't': percent = atoi(value);	break;
+			case 'b': baseline = value;			break;
+			case 'w': saveAs = value;			break;
+			default : usage = true;
+		}
+	}
+
+	if (usage || gRuns < 1 || percent > 100)
+	{
+		printf("Usage: bench [-n runs] [-w baseline] [-b baseline [-t percent]] [kernelcache ...]\n");
+		return 1;
+	}
+
+	runLogoCases();
+	runSyntheticCases();
+
+	for (; i < argc; i++)
+	{
+		if (!runKernelCacheCases(argv[i]))
+		{
+			failures++;
+		}
+	}
+
+	printf("%-44s %10s %10s %12s  %s\n", "Case", "bytes", "MB/s", "cycles/byte", "check");
+
+	for (i = 0; i < gCaseCount; i++)
+	{
+		BenchCase * benchCase = &gCases[i];
+
+		printf("%-44s %10lu %10.1f %12.2f  %s\n", benchCase->name, benchCase->bytes,
+			   ((double)benchCase->bytes * 1000) / (benchCase->nanoseconds ? benchCase->nanoseconds : 1),
+			   (double)benchCase->cycles / benchCase->bytes, benchCase->passed ? "ok" : "FAILED");
+
+		if (!benchCase->passed)
+		{
+			failures++;
+		}
+	}
+
+	if (baseline)
+	{
+		int regressions = checkBaseline(baseline, percent);
+
+		if (regressions < 0)
+		{
+			error("bench: cannot read %s\n", baseline);
+		}
+
+		failures += (regressions < 0) ? 1 : regressions;
+	}
+
+	if (saveAs && saveBaseline(saveAs) != 0)
+	{
+		error("bench: cannot write %s\n", saveAs);
+		failures++;
+	}
+
+	return (failures != 0);
+}
@@ -0,0 +1,49 @@
+/*
+ *
+ * host.h
+ *
+ * Host side (macOS/Linux) stand-ins for the BIOS services used by libsaio, so
+ * that the disk, file system, cache and XML code can be run (and timed) from a
+ * command line tool. INT 13h reads are served from raw disk image files.
+ *
+ */
+
+#ifndef __HOST_H
+#define __HOST_H
+
+#define HOST_MAX_DISKS			4		// BIOS devices 0x80 - 0x83.
+
+
+typedef struct HostDiskStats
+{
+	unsigned long		reads;			// ebiosread() calls.
+	unsigned long		sectors;		// Sectors read.
+	unsigned long long	bytes;			// Bytes read from the disk images.
+	unsigned long long	nanoseconds;	// Time spent in ebiosread() (including the injected latency).
+} HostDiskStats;
+
+
+/*
+ * host_bios.c
+ */
+extern void					hostInit(int biosdev);
+extern int					hostAttachDiskImage(int biosdev, const char * path);
+extern void					hostSetReadLatency(unsigned long usecPerCall, unsigned long usecPerSector);
+extern void					hostGetDiskStats(HostDiskStats * stats);
+extern void					hostResetDiskStats(void);
+
+
+/*
+ * host_io.c (only includes host headers).
+ */
+extern int					hostOpenImage(int unit, const char * path, unsigned long long * size);
+extern long					hostReadImage(int unit, unsigned long long offset, void * buffer, unsigned long length);
+extern void					hostDelay(unsigned long usec);
+extern unsigned long long	hostNanoseconds(void);
+extern unsigned long long	hostCycles(void);
+extern void *				hostLoadFile(const char * path, unsigned long padding, unsigned long * size);
+extern int					hostSaveFile(const char * path, const void * buffer, unsigned long size);
+extern void *				hostSharedAlloc(unsigned long size);
+extern int					hostRunIsolated(int (*function)(void * argument), void * argument);
+
+#endif /* !__HOST_H */
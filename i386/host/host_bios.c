@@ -0,0 +1,217 @@
+/*
+ *
+ * host_bios.c
+ *
+ * INT 13h stand-in for the host build. ebiosread() and get_drive_info() serve
+ * 512 byte sectors from the disk image attached to a BIOS device, with an
+ * optional (injected) latency per call and per sector, so that access patterns
+ * can be compared in a repeatable way.
+ *
+ */
+
+#include "libsaio.h"
+#include "bios.h"
+#include "bootstruct.h"
+#include "platform.h"
+
+#include "host.h"
+
+#define HOST_SECTOR_SIZE	512
+
+
+typedef struct HostDisk
+{
+	bool				attached;
+	unsigned long long	sectors;
+} HostDisk;
+
+
+// Memory that libsaio expects at fixed addresses (see memory.h).
+char gHostBIOSBuffer[BIOS_LEN];
+char gHostBootSector[512];
+char gHostLoadBuffer[LOAD_LEN];
+
+// Normally defined in platform.c and bootstruct.c
+PlatformInfo_t		gPlatform;
+PrivateBootInfo_t *	bootInfo;
+
+static HostDisk			gHostDisks[HOST_MAX_DISKS];
+static HostDiskStats	gHostDiskStats;
+
+static unsigned long	gCallLatency	= 0;	// Microseconds.
+static unsigned long	gSectorLatency	= 0;
+
+
+//==============================================================================
+// Returns the disk image of a BIOS device, or NULL when nothing is attached.
+
+static HostDisk * getHostDisk(int biosdev)
+{
+	int unit = (biosdev - BASE_HD_DRIVE);
+
+	if (unit < 0 || unit >= HOST_MAX_DISKS || !gHostDisks[unit].attached)
+	{
+		return NULL;
+	}
+
+	return &gHostDisks[unit];
+}
+
+
+//==============================================================================
+// Sets up the globals that libsaio expects boot() to have initialized.
+
+void hostInit(int biosdev)
+{
+	bzero(&gPlatform, sizeof(gPlatform));
+
+	gPlatform.BIOSDevice = biosdev;
+	gPlatform.ArchCPUType = CPU_TYPE_X86_64;
+
+	if (bootInfo == NULL)
+	{
+		bootInfo = (PrivateBootInfo_t *)calloc(1, sizeof(PrivateBootInfo_t));
+	}
+
+	hostResetDiskStats();
+}
+
+
+//==============================================================================
+// Returns 0 on success, -1 for invalid devices and unreadable images.
+
+int hostAttachDiskImage(int biosdev, const char * path)
+{
+	int unit = (biosdev - BASE_HD_DRIVE);
+	unsigned long long size;
+
+	if (unit < 0 || unit >= HOST_MAX_DISKS || hostOpenImage(unit, path, &size) < 0)
+	{
+		return -1;
+	}
+
+	gHostDisks[unit].attached = true;
+	gHostDisks[unit].sectors = (size / HOST_SECTOR_SIZE);
+
+	return 0;
+}
+
+
+//==============================================================================
+
+void hostSetReadLatency(unsigned long usecPerCall, unsigned long usecPerSector)
+{
+	gCallLatency = usecPerCall;
+	gSectorLatency = usecPerSector;
+}
+
+
+//==============================================================================
+
+void hostGetDiskStats(HostDiskStats * stats)
+{
+	*stats = gHostDiskStats;
+}
+
+
+//==============================================================================
+
+void hostResetDiskStats(void)
+{
+	bzero(&gHostDiskStats, sizeof(gHostDiskStats));
+}
+
+
+//==============================================================================
+// Replaces get_drive_info() in biosfn.c (reports an EBIOS capable hard drive).
+
+int get_drive_info(int drive, struct driveInfo *dp)
+{
+	HostDisk * disk = getHostDisk(drive);
+
+	bzero(dp, sizeof(struct driveInfo));
+	dp->biosdev = drive;
+
+	if (disk == NULL)
+	{
+		return -1;
+	}
+
+	dp->uses_ebios = (EBIOS_FIXED_DISK_ACCESS | EBIOS_ENHANCED_DRIVE_INFO);
+
+	dp->di.params.buf_size		= sizeof(dp->di.params);
+	dp->di.params.phys_nbps		= HOST_SECTOR_SIZE;
+	dp->di.params.phys_sectors	= disk->sectors;
+
+	dp->valid = 1;
+
+	return 0;
+}
+
+
+//==============================================================================
+// Replaces ebiosread() in biosfn.c (returns 0 or an INT 13h error code).
+
+int ebiosread(int dev, unsigned long long sec, int count)
+{
+	unsigned long long start = hostNanoseconds();
+
+	HostDisk * disk = getHostDisk(dev);
+
+	IO_STAT(biosCalls, 1);
+
+	if (disk == NULL)
+	{
+		return 0x01; // Invalid function or parameter.
+	}
+
+	if (count <= 0 || (count * HOST_SECTOR_SIZE) > BIOS_LEN || (sec + count) > disk->sectors)
+	{
+		return 0x04; // Sector not found.
+	}
+
+	if (hostReadImage(dev - BASE_HD_DRIVE, (sec * HOST_SECTOR_SIZE), gHostBIOSBuffer, (count * HOST_SECTOR_SIZE)) != (count * HOST_SECTOR_SIZE))
+	{
+		return 0x20; // Controller failure.
+	}
+
+	if (gCallLatency || gSectorLatency)
+	{
+		hostDelay(gCallLatency + (count * gSectorLatency));
+	}
+
+	gHostDiskStats.reads++;
+	gHostDiskStats.sectors += count;
+	gHostDiskStats.bytes += (count * HOST_SECTOR_SIZE);
+	gHostDiskStats.nanoseconds += (hostNanoseconds() - start);
+
+	return 0;
+}
+
+
+//==============================================================================
+// Replaces biosread() in biosfn.c (disk images are only served through EBIOS).
+
+int biosread(int dev, int cyl, int head, int sec, int num)
+{
+	return 0x01;
+}
+
+
+//==============================================================================
+// Replaces AllocateKernelMemory() in allocate.c (used by exportBootProfile).
+
+long AllocateKernelMemory(long inSize)
+{
+	return (long)calloc(1, inSize);
+}
+
+
+//==============================================================================
+// Replaces ThinFatFile() in load.c (which is not part of the host build). Fat
+// files are not thinned but read as a whole by LoadThinFatFile().
+
+long ThinFatFile(void **binary, unsigned long *length)
+{
+	return -1;
+}
@@ -0,0 +1,272 @@
+/*
+ *
+ * host_io.c
+ *
+ * Disk image access, timing and console output for the host build. This is the
+ * only file that includes host headers (libsaio has its own open/read/printf).
+ *
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "host.h"
+
+
+static FILE * gImages[HOST_MAX_DISKS];
+
+
+//==============================================================================
+// Returns 0 and the size of the image (in bytes) on success, -1 otherwise.
+
+int hostOpenImage(int unit, const char * path, unsigned long long * size)
+{
+	FILE * image;
+
+	if (unit < 0 || unit >= HOST_MAX_DISKS || (image = fopen(path, "rb")) == NULL)
+	{
+		return -1;
+	}
+
+	if (gImages[unit])
+	{
+		fclose(gImages[unit]);
+	}
+
+	gImages[unit] = image;
+
+	fseeko(image, 0, SEEK_END);
+	*size = (unsigned long long)ftello(image);
+
+	return 0;
+}
+
+
+//==============================================================================
+// Returns the number of bytes read (short reads past the end of the image).
+
+long hostReadImage(int unit, unsigned long long offset, void * buffer, unsigned long length)
+{
+	FILE * image = (unit >= 0 && unit < HOST_MAX_DISKS) ? gImages[unit] : NULL;
+
+	if (image == NULL || fseeko(image, (off_t)offset, SEEK_SET) != 0)
+	{
+		return -1;
+	}
+
+	return (long)fread(buffer, 1, length, image);
+}
+
+
+//==============================================================================
+
+unsigned long long hostNanoseconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((unsigned long long)now.tv_sec * 1000000000ULL) + now.tv_nsec;
+}
+
+
+//==============================================================================
+// Returns the time stamp counter (0 on non x86 hosts).
+
+unsigned long long hostCycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	unsigned int low, high;
+
+	__asm__ volatile("rdtsc" : "=a" (low), "=d" (high));
+
+	return ((unsigned long long)high << 32) | low;
+#else
+	return 0;
+#endif
+}
+
+
+//==============================================================================
+// Spins (instead of sleeping) so that short delays are accurate.
+
+void hostDelay(unsigned long usec)
+{
+	unsigned long long end = hostNanoseconds() + (usec * 1000ULL);
+
+	while (hostNanoseconds() < end);
+}
+
+
+//==============================================================================
+// Returns a malloc'ed copy of a host file (with 'padding' zero bytes appended)
+// and its size, or NULL on failure.
+
+void * hostLoadFile(const char * path, unsigned long padding, unsigned long * size)
+{
+	void * buffer = NULL;
+	FILE * file = fopen(path, "rb");
+
+	if (file && fseeko(file, 0, SEEK_END) == 0)
+	{
+		*size = (unsigned long)ftello(file);
+
+		if ((buffer = calloc(1, *size + padding)) != NULL)
+		{
+			rewind(file);
+
+			if (fread(buffer, 1, *size, file) != *size)
+			{
+				free(buffer);
+				buffer = NULL;
+			}
+		}
+	}
+
+	if (file)
+	{
+		fclose(file);
+	}
+
+	return buffer;
+}
+
+
+//==============================================================================
+// Returns 0 on success, -1 otherwise.
+
+int hostSaveFile(const char * path, const void * buffer, unsigned long size)
+{
+	FILE * file = fopen(path, "wb");
+
+	if (file == NULL)
+	{
+		return -1;
+	}
+
+	int status = (fwrite(buffer, 1, size, file) == size) ? 0 : -1;
+
+	return (fclose(file) == 0) ? status : -1;
+}
+
+
+//==============================================================================
+// Returns zero filled memory that is shared with the processes started by
+// hostRunIsolated() (so that they can return results), or NULL on failure.
+
+void * hostSharedAlloc(unsigned long size)
+{
+	void * memory = mmap(NULL, size, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_ANON), -1, 0);
+
+	return (memory == MAP_FAILED) ? NULL : memory;
+}
+
+
+//==============================================================================
+// Runs 'function' in a child process, so that every run starts with the same
+// (cold) caches and globals. Returns the exit status of the child, or -1.
+
+int hostRunIsolated(int (*function)(void * argument), void * argument)
+{
+	int status;
+
+	fflush(stdout);
+
+	pid_t pid = fork();
+
+	if (pid == 0)
+	{
+		status = function(argument);
+		fflush(stdout);
+
+		_exit(status);
+	}
+
+	if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+	{
+		return -1;
+	}
+
+	return WEXITSTATUS(status);
+}
+
+
+//==============================================================================
+// Stand-ins for console.c
+
+int verbose(const char * fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+
+	return 0;
+}
+
+
+//==============================================================================
+
+int error(const char * fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+
+	return 0;
+}
+
+
+//==============================================================================
+
+void stop(const char * fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+
+	exit(EXIT_FAILURE);
+}
+
+
+//==============================================================================
+// Stand-ins for zalloc.c (libsa.h maps malloc and calloc to these functions
+// when SAFE_MALLOC is set). The host build uses the libc allocator.
+
+void * safeMalloc(size_t size, const char * file, int line)
+{
+	void * memory = malloc(size);
+
+	if (memory == NULL)
+	{
+		stop("malloc(%lu) failed in %s:%d\n", (unsigned long)size, file, line);
+	}
+
+	return memory;
+}
+
+
+//==============================================================================
+
+void * safeCalloc(size_t count, size_t size, const char * file, int line)
+{
+	void * memory = calloc(count, size);
+
+	if (memory == NULL)
+	{
+		stop("calloc(%lu, %lu) failed in %s:%d\n", (unsigned long)count, (unsigned long)size, file, line);
+	}
+
+	return memory;
+}
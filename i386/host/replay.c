@@ -0,0 +1,509 @@
+/*
+ *
+ * replay.c
+ *
+ * Replays the file system accesses of a boot (boot() and loadDrivers()) against
+ * a disk image and reports the time, INT 13h calls and sectors read per phase.
+ * Every run is done in a new process, so that all runs start with cold caches.
+ *
+ * Usage: replay [-n runs] [-c usec per call] [-s usec per sector] [-w baseline] [-b baseline [-t percent]] image
+ *
+ * -w saves the median time, INT 13h calls and sectors of each phase, -b compares
+ * against a saved baseline and fails when a phase is more than 'percent' (default
+ * 10) and at least 100 usec slower, or does more INT 13h calls or reads more
+ * sectors than before.
+ *
+ */
+
+#include "sl.h"
+#include "platform.h"
+#include "xml.h"
+
+#include "host.h"
+
+#define MAX_RUNS				64
+#define MAX_KEXT_PATH_LENGTH	256		// Same as in drivers.c
+#define MIN_TIME_REGRESSION		100		// Smaller time differences (in usec) are ignored as noise.
+
+
+enum
+{
+	kReplayPartitionChain = 0,
+	kReplayPrefetch,
+	kReplayBootPlist,
+	kReplayKernelCacheLookup,
+	kReplayLoadKernelCache,
+	kReplayLoadKexts,
+	kReplayLoadModules,
+	kReplayPhaseCount
+};
+
+static const char * gPhaseNames[kReplayPhaseCount] =
+{
+	"initPartitionChain",
+	"prefetchBootIOTrace",
+	"loadCABootPlist",
+	"GetFileInfo(kernelcache)",
+	"LoadThinFatFile(kernelcache)",
+	"loadKexts",
+	"loadMatchedModules"
+};
+
+
+typedef struct ReplayPhase
+{
+	unsigned long long	nanoseconds;
+	long				result;			// Phase specific (file size, number of kexts etc).
+	HostDiskStats		disk;
+} ReplayPhase;
+
+typedef struct ReplayRun
+{
+	int					status;
+	ReplayPhase			phases[kReplayPhaseCount];
+} ReplayRun;
+
+// Executables of the kexts that loadMatchedModules() would load.
+typedef struct ReplayModule
+{
+	char *					path;
+	struct ReplayModule *	next;
+} ReplayModule;
+
+
+static ReplayModule * gModules = NULL;
+
+
+//==============================================================================
+// Follows loadPlist() in drivers.c Returns 1 for kexts with a (valid) plist.
+
+static long replayPlist(char * kextPath, bool isBundleType2)
+{
+	char plistSpec[MAX_KEXT_PATH_LENGTH];
+	TagPtr moduleDict = NULL, required, executable;
+
+	sprintf(plistSpec, "%s/%sInfo.plist", kextPath, (isBundleType2) ? "Contents/" : "");
+
+	long length = LoadFile(plistSpec);
+
+	if (length <= 0)
+	{
+		return 0;
+	}
+
+	char * buffer = malloc(length + 1);
+
+	memcpy(buffer, (char *)kLoadAddr, length);
+	buffer[length] = '\0';
+
+#if BINARY_PLIST_SUPPORT
+	if (XMLIsBinaryPlist(buffer, length))
+	{
+		length = XMLParseBinaryPlist(buffer, length, &moduleDict);
+	}
+	else
+#endif
+	length = ParseXMLFileInPlace(buffer, &moduleDict);
+
+	if (length == -1)
+	{
+		free(buffer);
+		return 0;
+	}
+
+	required = XMLGetProperty(moduleDict, kPropOSBundleRequired);
+	executable = XMLGetProperty(moduleDict, kPropCFBundleExecutable);
+
+	if (required && required->type == kTagTypeString && strcmp(required->string, "Safe Boot") && executable)
+	{
+		ReplayModule * module = malloc(sizeof(ReplayModule));
+
+		module->path = malloc(strlen(kextPath) + strlen(executable->string) + 18);
+		sprintf(module->path, "%s/%s%s", kextPath, (isBundleType2) ? "Contents/MacOS/" : "", executable->string);
+
+		module->next = gModules;
+		gModules = module;
+	}
+
+	XMLFreeTag(moduleDict);
+	free(buffer);
+
+	return 1;
+}
+
+
+//==============================================================================
+// Follows loadKexts() in drivers.c Returns the number of kexts found.
+
+static long replayKexts(char * targetFolder, bool isPluginRun)
+{
+	char kextPath[MAX_KEXT_PATH_LENGTH];
+	char pluginPath[MAX_KEXT_PATH_LENGTH];
+
+	long flags, time, index = 0, count = 0;
+	const char * name;
+
+	while (GetDirEntry(targetFolder, &index, &name, &flags, &time) != -1)
+	{
+		int nameLength = strlen(name);
+
+		if (((flags & kFileTypeMask) == kFileTypeDirectory) && nameLength > 5 && strcmp(name + (nameLength - 5), ".kext") == 0)
+		{
+			sprintf(kextPath, "%s/%s", targetFolder, name);
+
+			bool isBundleType2 = (GetFileInfo(kextPath, "Contents", &flags, &time) == 0);
+
+			count += replayPlist(kextPath, isBundleType2);
+
+			if (!isPluginRun)
+			{
+				sprintf(pluginPath, "%s/%sPlugIns", kextPath, (isBundleType2) ? "Contents/" : "");
+
+				count += replayKexts(pluginPath, true);
+			}
+		}
+	}
+
+	return count;
+}
+
+
+//==============================================================================
+// Follows loadMatchedModules() in drivers.c Returns the number of bytes read.
+
+static long replayModules(void)
+{
+	long total = 0;
+	void * binary;
+
+	ReplayModule * module;
+
+	for (module = gModules; module; module = module->next)
+	{
+		long length = LoadThinFatFile(module->path, &binary);
+
+		if (length == 0)
+		{
+			length = LoadFile(module->path);
+		}
+
+		if (length > 0)
+		{
+			total += length;
+		}
+	}
+
+	return total;
+}
+
+
+//==============================================================================
+
+static void beginPhase(ReplayPhase * phase)
+{
+	hostResetDiskStats();
+
+	phase->nanoseconds = hostNanoseconds();
+}
+
+
+//==============================================================================
+
+static void endPhase(ReplayPhase * phase, long result)
+{
+	phase->nanoseconds = (hostNanoseconds() - phase->nanoseconds);
+	phase->result = result;
+
+	hostGetDiskStats(&phase->disk);
+}
+
+
+//==============================================================================
+// Called in a new process by hostRunIsolated(). Returns 0 on success.
+
+static int replayBoot(void * argument)
+{
+	ReplayRun * run = (ReplayRun *)argument;
+	ReplayPhase * phases = run->phases;
+
+	long flags, time, length;
+	void * binary;
+	char bootFile[MAX_KEXT_PATH_LENGTH];
+
+	beginPhase(&phases[kReplayPartitionChain]);
+	initPartitionChain();
+	endPhase(&phases[kReplayPartitionChain], (gPlatform.BootVolume != NULL));
+
+	if (gPlatform.BootVolume == NULL)
+	{
+		error("replay: no HFS+ boot volume found.\n");
+		return 1;
+	}
+
+	beginPhase(&phases[kReplayPrefetch]);
+#if BOOT_IO_TRACE
+	prefetchBootIOTrace();
+#endif
+	endPhase(&phases[kReplayPrefetch], 0);
+
+	beginPhase(&phases[kReplayBootPlist]);
+	endPhase(&phases[kReplayBootPlist], (loadCABootPlist() == EFI_SUCCESS));
+
+	beginPhase(&phases[kReplayKernelCacheLookup]);
+
+	if (GetFileInfo(kKernelCachePath, kKernelCache, &flags, &time) == 0)
+	{
+		sprintf(bootFile, "%s/%s", kKernelCachePath, kKernelCache);
+		endPhase(&phases[kReplayKernelCacheLookup], 1);
+	}
+	else
+	{
+		strcpy(bootFile, "/System/Library/Kernels/kernel");
+		endPhase(&phases[kReplayKernelCacheLookup], 0);
+	}
+
+	beginPhase(&phases[kReplayLoadKernelCache]);
+	length = LoadThinFatFile(bootFile, &binary);
+	endPhase(&phases[kReplayLoadKernelCache], length);
+
+	beginPhase(&phases[kReplayLoadKexts]);
+	length = replayKexts("/System/Library/Extensions", false);
+	endPhase(&phases[kReplayLoadKexts], length);
+
+	beginPhase(&phases[kReplayLoadModules]);
+	length = replayModules();
+	endPhase(&phases[kReplayLoadModules], length);
+
+	run->status = 1;
+
+	return 0;
+}
+
+
+//==============================================================================
+// Returns the median of the phase time of all runs (in nanoseconds).
+
+static unsigned long long getMedian(ReplayRun * runs, int count, int phase)
+{
+	int i, j;
+	unsigned long long times[MAX_RUNS], tmp;
+
+	for (i = 0; i < count; i++)
+	{
+		times[i] = runs[i].phases[phase].nanoseconds;
+
+		for (j = i; j > 0 && times[j - 1] > times[j]; j--)
+		{
+			tmp = times[j];
+			times[j] = times[j - 1];
+			times[j - 1] = tmp;
+		}
+	}
+
+	return times[count / 2];
+}
+
+
+//==============================================================================
+// Saves the median time (in microseconds), calls and sectors of each phase
+// ("name usec calls sectors" lines). Returns 0 on success.
+
+static int saveBaseline(const char * path, ReplayRun * runs, int runCount)
+{
+	int phase;
+	unsigned long length = 0;
+
+	char * buffer = malloc(kReplayPhaseCount * 96);
+
+	for (phase = 0; phase < kReplayPhaseCount; phase++)
+	{
+		length += sprintf(&buffer[length], "%s %lu %lu %lu\n", gPhaseNames[phase], (unsigned long)(getMedian(runs, runCount, phase) / 1000),
+						  runs[0].phases[phase].disk.reads, runs[0].phases[phase].disk.sectors);
+	}
+
+	int status = hostSaveFile(path, buffer, length);
+
+	free(buffer);
+
+	return status;
+}
+
+
+//==============================================================================
+// Returns the number of phases that regressed against the baseline file, or -1
+// when it cannot be read.
+
+static int checkBaseline(const char * path, ReplayRun * runs, int runCount, unsigned long percent)
+{
+	int phase, regressions = 0;
+	unsigned long size, time, calls, sectors;
+
+	char * line, * end, * value, * buffer = hostLoadFile(path, 1, &size);
+
+	if (buffer == NULL)
+	{
+		return -1;
+	}
+
+	for (line = buffer; *line; line = end)
+	{
+		for (end = line; *end && *end != '\n'; end++);
+
+		if (*end)
+		{
+			*end++ = '\0';
+		}
+
+		for (value = line; *value && *value != ' '; value++);
+
+		if (*value == '\0')
+		{
+			continue;
+		}
+
+		*value++ = '\0';
+
+		time = strtoul(value, &value, 10);
+		calls = strtoul(value, &value, 10);
+		sectors = strtoul(value, &value, 10);
+
+		for (phase = 0; phase < kReplayPhaseCount; phase++)
+		{
+			if (strcmp(gPhaseNames[phase], line) == 0)
+			{
+				ReplayPhase * first = &runs[0].phases[phase];
+				unsigned long median = (unsigned long)(getMedian(runs, runCount, phase) / 1000);
+
+				if ((median * 100) > (time * (100 + percent)) && (median - time) >= MIN_TIME_REGRESSION)
+				{
+					printf("%s: %lu usec is more than %lu%% above the baseline (%lu usec).\n", line, median, percent, time);
+					regressions++;
+				}
+
+				// The I/O of a phase doesn't depend on timing, so any increase counts.
+				if (first->disk.reads > calls || first->disk.sectors > sectors)
+				{
+					printf("%s: %lu calls / %lu sectors, baseline %lu calls / %lu sectors.\n", line, first->disk.reads, first->disk.sectors, calls, sectors);
+					regressions++;
+				}
+			}
+		}
+	}
+
+	free(buffer);
+
+	return regressions;
+}
+
+
+//==============================================================================
+
+int main(int argc, char * argv[])
+{
+	int i, phase, runCount = 5, failures = 0;
+	unsigned long callLatency = 0, sectorLatency = 0, percent = 10;
+	unsigned long long minimum;
+	char * image = NULL, * baseline = NULL, * saveAs = NULL;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && (i + 1) < argc)
+		{
+			runCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-c") == 0 && (i + 1) < argc)
+		{
+			callLatency = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-s") == 0 && (i + 1) < argc)
+		{
+			sectorLatency = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-w") == 0 && (i + 1) < argc)
+		{
+			saveAs = argv[++i];
+		}
+		else if (strcmp(argv[i], "-b") == 0 && (i + 1) < argc)
+		{
+			baseline = argv[++i];
+		}
+		else if (strcmp(argv[i], "-t") == 0 && (i + 1) < argc)
+		{
+			percent = atoi(argv[++i]);
+		}
+		else
+		{
+			image = argv[i];
+		}
+	}
+
+	if (image == NULL || runCount < 1 || runCount > MAX_RUNS || percent > 100)
+	{
+		printf("Usage: replay [-n runs (1-%d)] [-c usec per call] [-s usec per sector] [-w baseline] [-b baseline [-t percent]] image\n", MAX_RUNS);
+		return 1;
+	}
+
+	hostInit(0x80);
+	hostSetReadLatency(callLatency, sectorLatency);
+
+	if (hostAttachDiskImage(0x80, image) < 0)
+	{
+		error("replay: cannot open %s\n", image);
+		return 1;
+	}
+
+	ReplayRun * runs = hostSharedAlloc(sizeof(ReplayRun) * runCount);
+
+	if (runs == NULL)
+	{
+		return 1;
+	}
+
+	for (i = 0; i < runCount; i++)
+	{
+		if (hostRunIsolated(replayBoot, &runs[i]) != 0 || runs[i].status == 0)
+		{
+			error("replay: run %d failed.\n", i + 1);
+			return 1;
+		}
+	}
+
+	// The disk statistics and results are the same for all runs (only the time differs).
+	printf("%-30s %10s %10s %8s %10s %10s\n", "Phase", "min ms", "median ms", "calls", "sectors", "result");
+
+	for (phase = 0; phase < kReplayPhaseCount; phase++)
+	{
+		ReplayPhase * first = &runs[0].phases[phase];
+
+		for (minimum = first->nanoseconds, i = 1; i < runCount; i++)
+		{
+			if (runs[i].phases[phase].nanoseconds < minimum)
+			{
+				minimum = runs[i].phases[phase].nanoseconds;
+			}
+		}
+
+		printf("%-30s %10.3f %10.3f %8lu %10lu %10ld\n", gPhaseNames[phase], (double)minimum / 1000000,
+			   (double)getMedian(runs, runCount, phase) / 1000000, first->disk.reads, first->disk.sectors, first->result);
+	}
+
+	if (baseline)
+	{
+		int regressions = checkBaseline(baseline, runs, runCount, percent);
+
+		if (regressions < 0)
+		{
+			error("replay: cannot read %s\n", baseline);
+		}
+
+		failures += (regressions < 0) ? 1 : regressions;
+	}
+
+	if (saveAs && saveBaseline(saveAs, runs, runCount) != 0)
+	{
+		error("replay: cannot write %s\n", saveAs);
+		failures++;
+	}
+
+	return (failures != 0);
+}
@@ -0,0 +1,129 @@
+/*
+ *
+ * arena.c
+ *
+ * Scoped arena allocator. Allocations are carved out of (malloc'd) chunks and
+ * cannot be freed individually. arena_reset() releases everything in one go.
+ *
+ */
+
+#include "libsa.h"
+
+
+struct arena_chunk
+{
+	struct arena_chunk *	next;
+	size_t					size;	// Usable size (excluding this header).
+	size_t					used;
+} __attribute__((aligned(16)));
+
+struct arena
+{
+	struct arena_chunk *	chunks;	// Current chunk first, the initial chunk is the last one.
+	size_t					chunkSize;
+};
+
+
+//==============================================================================
+
+static struct arena_chunk * arena_new_chunk(size_t size)
+{
+	struct arena_chunk * chunk = malloc(sizeof(struct arena_chunk) + size);
+
+	if (chunk)
+	{
+		chunk->next = NULL;
+		chunk->size = size;
+		chunk->used = 0;
+	}
+
+	return chunk;
+}
+
+
+//==============================================================================
+
+arena_t * arena_create(size_t chunkSize)
+{
+	arena_t * arena = malloc(sizeof(arena_t));
+
+	if (arena)
+	{
+		arena->chunkSize = chunkSize ? ((chunkSize + 0xf) & ~0xf) : ARENA_DEFAULT_CHUNK_SIZE;
+		arena->chunks = arena_new_chunk(arena->chunkSize);
+
+		if (arena->chunks == NULL)
+		{
+			free(arena);
+			return NULL;
+		}
+	}
+
+	return arena;
+}
+
+
+//==============================================================================
+// Returns 16 byte aligned memory (not cleared) or NULL when out of memory.
+
+void * arena_alloc(arena_t * arena, size_t size)
+{
+	struct arena_chunk * chunk = arena->chunks;
+
+	size = ((size + 0xf) & ~0xf);
+
+	if ((chunk->size - chunk->used) < size)
+	{
+		// Oversized requests get a chunk of their own.
+		chunk = arena_new_chunk((size > arena->chunkSize) ? size : arena->chunkSize);
+
+		if (chunk == NULL)
+		{
+			return NULL;
+		}
+
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	chunk->used += size;
+
+	return ((char *)(chunk + 1) + chunk->used - size);
+}
+
+
+//==============================================================================
+// Returns true when 'pointer' lies in one of the chunks of the arena.
+
+bool arena_contains(arena_t * arena, const void * pointer)
+{
+	struct arena_chunk * chunk = arena->chunks;
+
+	for (; chunk; chunk = chunk->next)
+	{
+		if ((const char *)pointer >= (const char *)(chunk + 1) && (const char *)pointer < ((const char *)(chunk + 1) + chunk->used))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//==============================================================================
+// Releases all allocations. The initial chunk is kept for reuse.
+
+void arena_reset(arena_t * arena)
+{
+	struct arena_chunk * chunk = arena->chunks;
+
+	while (chunk->next)
+	{
+		arena->chunks = chunk->next;
+		free(chunk);
+		chunk = arena->chunks;
+	}
+
+	chunk->used = 0;
+}
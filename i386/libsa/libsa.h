@@ -39,6 +39,19 @@
 #include "../config/settings.h"
 
 
+/*
+ * arena.c
+ */
+#define ARENA_DEFAULT_CHUNK_SIZE	16384
+
+typedef struct arena arena_t;
+
+extern arena_t * arena_create(size_t chunkSize);
+extern void *    arena_alloc(arena_t * arena, size_t size);
+extern void      arena_reset(arena_t * arena);
+extern bool      arena_contains(arena_t * arena, const void * pointer);
+
+
 /*
  * boot.c
  */
@@ -124,12 +137,19 @@ extern unsigned long long strtouq(const char *nptr, char ** endptr, int base);
 
 #if SAFE_MALLOC
 	#define malloc(size) safeMalloc(size, __FILE__, __LINE__)
+	#define calloc(count, size) safeCalloc(count, size, __FILE__, __LINE__)
 
 	extern void   mallocInit(char * start, int size, int nodes, void (*malloc_error)(char *, size_t, const char *, int));
 	extern void * safeMalloc(size_t size, const char *file, int line);
+	extern void * safeCalloc(size_t count, size_t size, const char *file, int line);
 #else
 	extern void   mallocInit(char * start, int size, int nodes, void (*malloc_error)(char *, size_t));
 	extern void * malloc(size_t size);
+	extern void * calloc(size_t count, size_t size);
+#endif
+
+#if DYNAMIC_MEMORY_LAYOUT
+	extern void   mallocRelocate(char * start, int size);
 #endif
 
 extern void   free(void * start);
@@ -61,10 +61,21 @@
 #define BOOT2_SEG			0x2000								// Disk sector offset.
 #define BOOT2_OFS			0x0200								// 512 Bytes.
 
-#define BIOS_ADDR			0x8000								// BIOS disk I/O buffer.
-#define BIOS_LEN			0x8000								// 32 KB (dividable by 512 and 2048).
+#if HOST_SAIO
+	// Host build (see i386/host/Makefile) where the BIOS disk I/O buffer, boot
+	// sector and file load buffer are arrays in host_bios.c (no fixed addresses).
+	extern char gHostBIOSBuffer[];
+	extern char gHostBootSector[];
+	extern char gHostLoadBuffer[];
+
+	#define BIOS_ADDR		((unsigned long)gHostBIOSBuffer)
+	#define BOOT0_ADDR		((unsigned long)gHostBootSector)
+#else
+	#define BIOS_ADDR		0x8000								// BIOS disk I/O buffer.
+	#define BOOT0_ADDR		0x7E00								// Load address of boot0.
+#endif
 
-#define BOOT0_ADDR			0x7E00								// Load address of boot0.
+#define BIOS_LEN			0x8000								// 32 KB (dividable by 512 and 2048).
 
 #define ADDR32(seg, ofs)	(((seg) << 4 ) + (ofs))
 
@@ -91,20 +102,55 @@
 
 //							0x00100000L
 #define KERNEL_ADDR			(VIDEO_ADDR + VIDEO_LEN)			// Kernel and MKexts/drivers.
-#define KERNEL_LEN			0x08000000L							// Size: 128 MB.
+#define KERNEL_FIXED_LEN	0x08000000L							// Size: 128 MB.
 																//
 																// Note: Can cause a stop("Kernel overflows available space")
 // Based on KERNEL_LEN		0x04100000L
-#define ZALLOC_ADDR			(KERNEL_ADDR + KERNEL_LEN)			// Zalloc area.
-#define ZALLOC_LEN			0x10000000L							// Size: 256 MB.
+#define ZALLOC_FIXED_ADDR	(KERNEL_ADDR + KERNEL_FIXED_LEN)	// Zalloc area.
+#define ZALLOC_FIXED_LEN	0x10000000L							// Size: 256 MB.
 
 // Based on ZALLOC_LEN		0x14100000L
-#define LOAD_ADDR			(ZALLOC_ADDR + ZALLOC_LEN)			// File load buffer.
-#define LOAD_LEN			0x05F80000L							// Size: 95 MB.
+#define LOAD_FIXED_ADDR		(ZALLOC_FIXED_ADDR + ZALLOC_FIXED_LEN)	// File load buffer.
+#define LOAD_FIXED_LEN		0x05F80000L							// Size: 95 MB.
 
 																// Location of data fed to boot2 by the prebooter
 // Based on LOAD_LEN		0x1A080000L
-#define PREBOOT_DATA		(LOAD_ADDR + LOAD_LEN)				// Room for a 195 MB RAM disk image (with 512 MB System Memory).
+#define PREBOOT_DATA		(LOAD_FIXED_ADDR + LOAD_FIXED_LEN)	// Room for a 195 MB RAM disk image (with 512 MB System Memory).
+
+#if (DYNAMIC_MEMORY_LAYOUT && !HOST_SAIO)
+	// Window sizes (and addresses) chosen by planMemoryLayout() in allocate.c
+	// from the E820 memory map. The fixed layout is used until then.
+	#ifndef __ASSEMBLER__
+		typedef struct MemoryLayout
+		{
+			unsigned long	KernelLength;
+			unsigned long	ZallocAddress;
+			unsigned long	ZallocLength;
+			unsigned long	LoadAddress;
+			unsigned long	LoadLength;
+		} MemoryLayout;
+
+		extern MemoryLayout gMemoryLayout;
+	#endif
+
+	#define KERNEL_LEN		gMemoryLayout.KernelLength
+	#define ZALLOC_ADDR		gMemoryLayout.ZallocAddress
+	#define ZALLOC_LEN		gMemoryLayout.ZallocLength
+	#define LOAD_ADDR		gMemoryLayout.LoadAddress
+	#define LOAD_LEN		gMemoryLayout.LoadLength
+#else
+	#define KERNEL_LEN		KERNEL_FIXED_LEN
+	#define ZALLOC_ADDR		ZALLOC_FIXED_ADDR
+	#define ZALLOC_LEN		ZALLOC_FIXED_LEN
+
+	#if HOST_SAIO
+		#define LOAD_ADDR	((unsigned long)gHostLoadBuffer)
+	#else
+		#define LOAD_ADDR	LOAD_FIXED_ADDR
+	#endif
+
+	#define LOAD_LEN		LOAD_FIXED_LEN
+#endif
 
 
 #define TFTP_ADDR			LOAD_ADDR							// TFTP download buffer (not used in RevoBoot).
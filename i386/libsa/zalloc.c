@@ -27,6 +27,11 @@
  *
  * Sam's simple memory allocator.
  *
+ * Updates:
+ *			- Sorted node arrays replaced by inline block headers. Small blocks are
+ *			  kept on per size class free lists, and large blocks are kept in log2
+ *			  bins and coalesced with their neighbours (boundary tags) on free.
+ *
  */
 
 #include "libsa.h"
@@ -40,16 +45,55 @@
 	int zout;
 #endif
 
-typedef struct {
-	char * start;
-	size_t size;
-} zmem;
-
-static zmem * zalloced;
-static zmem * zavailable;
-static short  availableNodes, allocedNodes, totalNodes;
-static char * zalloc_base;
-static char * zalloc_end;
+/*
+ * Every block starts with a 16 byte header, which keeps the returned pointers
+ * 16 byte aligned. The size includes the header, and prevSize is the size of
+ * the block right before it (boundary tag), which makes coalescing O(1).
+ */
+typedef struct zheader
+{
+	size_t		size;		// Block size (including header) or'ed with ZINUSE.
+	size_t		prevSize;	// Size of the previous block (0 for the first block).
+	uint32_t	magic;		// ZMAGIC (allocated), ZQUICK (small free list) or ZFREE.
+	uint32_t	reserved;
+} __attribute__((aligned(16))) zheader;
+
+// Free (large) blocks also have their bin links stored in the header.
+typedef struct zfree
+{
+	zheader			header;
+	struct zfree *	next;
+	struct zfree *	prev;
+} zfree;
+
+#define ZINUSE			1
+#define ZMAGIC			0x5a414c43	// 'ZALC'
+#define ZQUICK			0x5a51434b	// 'ZQCK'
+#define ZFREE			0x5a465245	// 'ZFRE'
+
+#define ZHEADER_SIZE	sizeof(zheader)
+#define ZMIN_BLOCK		((sizeof(zfree) + 0xf) & ~0xf)	// Header plus free list links.
+#define ZSMALL_MAX		528			// Blocks up to 512 bytes (plus header) are kept on size class lists.
+#define ZSMALL_CLASSES	((ZSMALL_MAX / 16) + 1)
+#define ZBINS			32			// One bin per power of two (large blocks).
+
+#define ZBLOCK_SIZE(z)	((z)->size & ~ZINUSE)
+#define ZNEXT_BLOCK(z)	((zheader *)((char *)(z) + ZBLOCK_SIZE(z)))
+#define ZQUICK_NEXT(z)	(*(zheader **)((char *)(z) + ZHEADER_SIZE))
+
+static zheader *	zsmall[ZSMALL_CLASSES];		// Size class free lists (single linked, see ZQUICK_NEXT).
+static zfree *		zbins[ZBINS];				// Large block bins (double linked).
+static uint32_t		zbinMap;					// Bit set for each non-empty bin.
+
+static char *		zalloc_base;
+static char *		zalloc_end;
+static char *		ztop;						// Start of the unused space.
+static size_t		ztopPrevSize;				// Size of the block right before ztop.
+
+#if DYNAMIC_MEMORY_LAYOUT
+static char *		zretired_base;				// Bootstrap heap (see mallocRelocate).
+static char *		zretired_top;
+#endif
 
 #if SAFE_MALLOC
 	static void		(*zerror)(char *, size_t, const char *, int);
@@ -57,17 +101,13 @@ static char * zalloc_end;
 	static void		(*zerror)(char *, size_t);
 #endif
 
-static void   zallocate(char * start,int size);
-static void   zinsert(zmem * zp, int ndx);
-static void   zdelete(zmem * zp, int ndx);
-static void   zcoalesce(void);
+static void		zbinInsert(zfree * block);
+static void		zbinRemove(zfree * block);
 
 #if ZDEBUG
 	size_t zalloced_size;
 #endif
 
-#define ZALLOC_NODES	32767 /* This was 16384 */
-
 
 #if SAFE_MALLOC
 	static void mallocError(char *addr, size_t size, const char *file, int line)
@@ -80,32 +120,110 @@ static void   zcoalesce(void);
 #endif
 }
 
-// define the block of memory that the allocator will use
+// define the block of memory that the allocator will use (nodes is no longer used).
 #if SAFE_MALLOC
 	void mallocInit(char * start, int size, int nodes, void (*malloc_err_fn)(char *, size_t, const char *, int))
 #else
 	void mallocInit(char * start, int size, int nodes, void (*malloc_err_fn)(char *, size_t))
 #endif
 {
-	zalloc_base         = start ? start : (char *)ZALLOC_ADDR;
-	totalNodes          = nodes ? nodes : ZALLOC_NODES;
-	zalloced            = (zmem *) zalloc_base;
-	zavailable          = (zmem *) zalloc_base + sizeof(zmem) * totalNodes;
-	zavailable[0].start = (char *)zavailable + sizeof(zmem) * totalNodes;
+	zalloc_base	= start ? start : (char *)ZALLOC_ADDR;
 
 	if (size == 0)
 	{
 		size = ZALLOC_LEN;
 	}
 
-	zavailable[0].size  = size - (zavailable[0].start - zalloc_base);
-    zalloc_end          = zalloc_base + size;
-	availableNodes      = 1;
-	allocedNodes        = 0;
-    zerror              = malloc_err_fn ? malloc_err_fn : mallocError;
+	zalloc_end		= zalloc_base + size;
+	ztop			= (char *)(((unsigned long)zalloc_base + 0xf) & ~0xf);
+	ztopPrevSize	= 0;
+	zbinMap			= 0;
+
+	bzero(zsmall, sizeof(zsmall));
+	bzero(zbins, sizeof(zbins));
+
+	zerror			= malloc_err_fn ? malloc_err_fn : mallocError;
 }
 
-#define BEST_FIT 1
+
+#if DYNAMIC_MEMORY_LAYOUT
+//==============================================================================
+// Called by planMemoryLayout() to move the heap from the (small) bootstrap area
+// to the zalloc area. Blocks allocated before the move stay where they are, and
+// are never reused (free ignores them).
+
+void mallocRelocate(char * start, int size)
+{
+	zretired_base	= zalloc_base;
+	zretired_top	= ztop;
+
+	mallocInit(start, size, 0, zerror);
+}
+#endif
+
+
+//==============================================================================
+
+static inline int zbinIndex(size_t size)
+{
+	return (31 - __builtin_clz(size));
+}
+
+
+//==============================================================================
+
+static void zbinInsert(zfree * block)
+{
+	int bin = zbinIndex(block->header.size);
+
+	block->header.magic = ZFREE;
+	block->prev = NULL;
+	block->next = zbins[bin];
+
+	if (block->next)
+	{
+		block->next->prev = block;
+	}
+
+	zbins[bin] = block;
+	zbinMap |= (1 << bin);
+
+	// Update boundary tag of the next block.
+	if ((char *)ZNEXT_BLOCK(&block->header) < ztop)
+	{
+		ZNEXT_BLOCK(&block->header)->prevSize = block->header.size;
+	}
+}
+
+
+//==============================================================================
+
+static void zbinRemove(zfree * block)
+{
+	int bin = zbinIndex(block->header.size);
+
+	if (block->prev)
+	{
+		block->prev->next = block->next;
+	}
+	else
+	{
+		zbins[bin] = block->next;
+
+		if (zbins[bin] == NULL)
+		{
+			zbinMap &= ~(1 << bin);
+		}
+	}
+
+	if (block->next)
+	{
+		block->next->prev = block->prev;
+	}
+}
+
+
+//==============================================================================
 
 #if SAFE_MALLOC
 	void * safeMalloc(size_t size, const char *file, int line)
@@ -113,271 +231,282 @@ static void   zcoalesce(void);
 	void * malloc(size_t size)
 #endif
 {
-	int    i;
-#if BEST_FIT
-    int    bestFit;
-    size_t smallestSize;
-#endif
+	int bin;
+
+	uint32_t map;
+
+	zheader * block = NULL;
+
 	char * ret = 0;
 
 	if ( !zalloc_base )
 	{
 		// this used to follow the bss but some bios' corrupted it...
-		mallocInit((char *)ZALLOC_ADDR, ZALLOC_LEN, ZALLOC_NODES, mallocError);
+		mallocInit((char *)ZALLOC_ADDR, ZALLOC_LEN, 0, mallocError);
 	}
 
-	size = ((size + 0xf) & ~0xf);
-
-    if (size == 0 && zerror)
+	if (size == 0 && zerror)
 #if SAFE_MALLOC
-        (*zerror)((char *)0xdeadbeef, 0, file, line);
+		(*zerror)((char *)0xdeadbeef, 0, file, line);
 #else
-        (*zerror)((char *)0xdeadbeef, 0);
+		(*zerror)((char *)0xdeadbeef, 0);
 #endif
 
-#if BEST_FIT
-    smallestSize = 0;
-    bestFit = -1;
-#endif
- 
-	for (i = 0; i < availableNodes; i++)
+	size = ((size + 0xf) & ~0xf) + ZHEADER_SIZE;
+
+	if (size < ZMIN_BLOCK)
+	{
+		size = ZMIN_BLOCK;
+	}
+
+	// Small blocks: O(1) from the size class free list.
+	if (size <= ZSMALL_MAX && zsmall[size >> 4])
+	{
+		block = zsmall[size >> 4];
+		zsmall[size >> 4] = ZQUICK_NEXT(block);
+		goto done;
+	}
+
+	// Large (or new small) blocks: first fit in the own bin, then any block of a larger bin.
+	bin = zbinIndex(size);
+
+	for (block = (zheader *)zbins[bin]; block; block = (zheader *)((zfree *)block)->next)
 	{
-		/*
-		 * Find node with equal size, or if not found, then smallest node that fits.
-		 */
-		if (zavailable[i].size == size)
+		if (block->size >= size)
 		{
-			zallocate(ret = zavailable[i].start, size);
-			zdelete(zavailable, i); availableNodes--;
-			goto done;
+			break;
 		}
-#if BEST_FIT
-        else if ((zavailable[i].size > size) && ((smallestSize == 0) || (zavailable[i].size < smallestSize)))
-        {
-                bestFit = i;
-                smallestSize = zavailable[i].size;
-        }
-#else
-		else if (zavailable[i].size > size)
+	}
+
+	if (block == NULL && (map = (zbinMap & ~((2u << bin) - 1))) != 0)
+	{
+		block = (zheader *)zbins[__builtin_ctz(map)];
+	}
+
+	if (block)
+	{
+		zbinRemove((zfree *)block);
+
+		// Split off the remainder when it is large enough.
+		if ((block->size - size) >= ZMIN_BLOCK)
 		{
-			zallocate(ret = zavailable[i].start, size);
-			zavailable[i].start += size;
-			zavailable[i].size  -= size;
-			goto done;
+			zheader * remainder = (zheader *)((char *)block + size);
+			remainder->size = (block->size - size);
+			remainder->prevSize = size;
+			block->size = size;
+			zbinInsert((zfree *)remainder);
 		}
-#endif
-    }
-#if BEST_FIT
-    if (bestFit != -1)
-    {
-        zallocate(ret = zavailable[bestFit].start, size);
-        zavailable[bestFit].start += size;
-        zavailable[bestFit].size  -= size;
-    }
-#endif
+	}
+	else if ((ztop + size) <= zalloc_end)
+	{
+		block = (zheader *)ztop;
+		block->size = size;
+		block->prevSize = ztopPrevSize;
+		ztop += size;
+		ztopPrevSize = size;
+	}
 
 done:
-	if ((ret == 0) || (ret + size >= zalloc_end))
-    {
+	if (block)
+	{
+		block->size |= ZINUSE;
+		block->magic = ZMAGIC;
+		ret = (char *)block + ZHEADER_SIZE;
+		size = (ZBLOCK_SIZE(block) - ZHEADER_SIZE);
+	}
+
+	if ((ret == 0) || (ret + size > zalloc_end))
+	{
 		if (zerror)
 #if SAFE_MALLOC
-            (*zerror)(ret, size, file, line);
+			(*zerror)(ret, size, file, line);
 #else
-            (*zerror)(ret, size);
+			(*zerror)(ret, size);
 #endif
-    }
+	}
 
+	/*
+	 * Note: New blocks are no longer zeroed (use calloc for that) because most
+	 * large blocks, like the kernel and file buffers, are overwritten anyway.
+	 */
+#if DEBUG_MALLOC_POISON
 	if (ret != 0)
-		bzero(ret, size);
+		memset(ret, 0xa5, size);
+#endif
 
 #if ZDEBUG
-    zalloced_size += size;
+	zalloced_size += size;
 #endif
 	return (void *) ret;
 }
 
-void free(void * pointer)
-{
-    unsigned long rp;
-	int i, found = 0;
-    size_t tsize = 0;
-	char * start = pointer;
-
-#if i386    
-    // Get return address of our caller,
-    // in case we have to report an error below.
-    asm volatile ("movl %%esp, %%eax\n\t"
-                  "subl $4, %%eax\n\t"
-                  "movl 0(%%eax), %%eax" : "=a" (rp));
-#else
-	rp = 0;
-#endif
 
-	if (!start)
-	{
-        return;
-	}
-
-	for (i = 0; i < allocedNodes; i++)
-	{
-		if (zalloced[i].start == start)
-		{
-			tsize = zalloced[i].size;
-#if ZDEBUG
-			zout -= tsize;
-			printf("    zz out %d\n", zout);
-#endif
-			zdelete(zalloced, i); allocedNodes--;
-			found = 1;
-#if ZDEBUG
-            memset(pointer, 0x5A, tsize);
-#endif
-			break;
-		}
-	}
+//==============================================================================
 
-	if (!found)
-    {
-        if (zerror)
 #if SAFE_MALLOC
-            (*zerror)(pointer, rp, "free", 0);
+	void * safeCalloc(size_t count, size_t size, const char *file, int line)
 #else
-            (*zerror)(pointer, rp);
-#endif
-        else
-           return;
-    }
-#if ZDEBUG
-        zalloced_size -= tsize;
+	void * calloc(size_t count, size_t size)
 #endif
+{
+	void * ret = NULL;
 
-	for (i = 0; i < availableNodes; i++)
+	// Multiplication overflow check.
+	if (size && count > (~(size_t)0 / size))
 	{
-		if ((start + tsize) == zavailable[i].start)  // merge it in
-		{
-			zavailable[i].start = start;
-			zavailable[i].size += tsize;
-			zcoalesce();
-			return;
-		}
-
-		if ((i > 0) && (zavailable[i-1].start + zavailable[i-1].size == start))
-		{
-			zavailable[i-1].size += tsize;
-			zcoalesce();
-			return;
-		}
-
-		if ((start + tsize) < zavailable[i].start)
-		{
-            if (++availableNodes > totalNodes)
-            {
-                if (zerror)
+		if (zerror)
 #if SAFE_MALLOC
-                    (*zerror)((char *)0xf000f000, 0, "free", 0);
+			(*zerror)((char *)0xdeadbeef, size, file, line);
 #else
-                    (*zerror)((char *)0xf000f000, 0);
+			(*zerror)((char *)0xdeadbeef, size);
 #endif
-            }
-			zinsert(zavailable, i); 
-			zavailable[i].start = start;
-			zavailable[i].size = tsize;
-			return;
-		}
+		return NULL;
 	}
 
-    if (++availableNodes > totalNodes)
-    {
-        if (zerror)
 #if SAFE_MALLOC
-            (*zerror)((char *)0xf000f000, 1, "free", 0);
+	ret = safeMalloc(count * size, file, line);
 #else
-            (*zerror)((char *)0xf000f000, 1);
+	ret = malloc(count * size);
 #endif
-    }
 
-	zavailable[i].start = start;
-	zavailable[i].size  = tsize;
-	zcoalesce();
+	if (ret)
+	{
+		bzero(ret, count * size);
+	}
 
-	return;
+	return ret;
 }
 
-static void zallocate(char * start,int size)
+
+//==============================================================================
+
+void free(void * pointer)
 {
+	unsigned long rp;
+	size_t size;
 
-#if ZDEBUG
-	zout += size;
-	printf("    alloc %d, total 0x%x\n", size, zout);
+	zheader * block = (zheader *)((char *)pointer - ZHEADER_SIZE);
+	zheader * neighbour;
+
+#if i386
+	// Get return address of our caller,
+	// in case we have to report an error below.
+	asm volatile ("movl %%esp, %%eax\n\t"
+				  "subl $4, %%eax\n\t"
+				  "movl 0(%%eax), %%eax" : "=a" (rp));
+#else
+	rp = 0;
 #endif
 
-	zalloced[allocedNodes].start = start;
-	zalloced[allocedNodes].size  = size;
+	if (!pointer)
+	{
+		return;
+	}
 
-	if (++allocedNodes > totalNodes)
-    {
-        if (zerror)
+#if DYNAMIC_MEMORY_LAYOUT
+	if ((char *)pointer >= zretired_base && (char *)pointer < zretired_top)
+	{
+		return;
+	}
+#endif
+
+	// Catches double frees and pointers that we didn't hand out.
+	if ((char *)block < zalloc_base || (char *)pointer >= ztop || block->magic != ZMAGIC)
+	{
+		if (zerror)
 #if SAFE_MALLOC
-            (*zerror)((char *)0xf000f000, 2, "zallocate", 0);
+			(*zerror)(pointer, rp, "free", 0);
 #else
-            (*zerror)((char *)0xf000f000, 2);
+			(*zerror)(pointer, rp);
 #endif
-    };
-}
+		return;
+	}
 
-static void zinsert(zmem * zp, int ndx)
-{
-	int i;
-	zmem *z1, *z2;
+	size = ZBLOCK_SIZE(block);
 
-	i  = totalNodes-2;
-	z1 = zp + i;
-	z2 = z1 + 1;
+#if ZDEBUG
+	zalloced_size -= (size - ZHEADER_SIZE);
+	memset(pointer, 0x5A, (size - ZHEADER_SIZE));
+#endif
 
-	for (; i >= ndx; i--, z1--, z2--)
+	/*
+	 * Small blocks go onto their size class list (next pointer stored in the
+	 * payload) and stay marked as in use, so that they never coalesce.
+	 */
+	if (size <= ZSMALL_MAX)
 	{
-        *z2 = *z1;
+		block->magic = ZQUICK;
+		ZQUICK_NEXT(block) = zsmall[size >> 4];
+		zsmall[size >> 4] = block;
+		return;
 	}
-}
 
-static void zdelete(zmem * zp, int ndx)
-{
-	int i;
-	zmem *z1, *z2;
+	block->size = size;
 
-	z1 = zp + ndx;
-	z2 = z1 + 1;
+	// Clear the magic first, since the header ends up in the middle of a free block
+	// when it is merged into the previous one (double frees must still be caught).
+	block->magic = ZFREE;
 
-	for (i = ndx; i < totalNodes - 1; i++, z1++, z2++)
+	// Coalesce with the previous block.
+	if (block->prevSize)
 	{
-        *z1 = *z2;
+		neighbour = (zheader *)((char *)block - block->prevSize);
+
+		if ((neighbour->size & ZINUSE) == 0)
+		{
+			zbinRemove((zfree *)neighbour);
+			neighbour->size += block->size;
+			block = neighbour;
+		}
 	}
-}
 
-static void zcoalesce(void)
-{
-	int i;
+	neighbour = ZNEXT_BLOCK(block);
 
-	for (i = 0; i < availableNodes-1; i++)
+	// Return the block to the unused space, or coalesce with the next block.
+	if ((char *)neighbour == ztop)
 	{
-		if ( zavailable[i].start + zavailable[i].size == zavailable[i + 1].start )
-		{
-			zavailable[i].size += zavailable[i + 1].size;
-			zdelete(zavailable, i + 1); availableNodes--;
-			return;
-		}
-	}	
+		ztop = (char *)block;
+		ztopPrevSize = block->prevSize;
+		return;
+	}
+
+	if ((neighbour->size & ZINUSE) == 0)
+	{
+		zbinRemove((zfree *)neighbour);
+		block->size += neighbour->size;
+	}
+
+	zbinInsert((zfree *)block);
 }
 
-/* This is the simplest way possible.  Should fix this. */
+
+//==============================================================================
+
 void * realloc(void * start, size_t newsize)
 {
-#if SAFE_MALLOC
-    void * newstart = safeMalloc(newsize, __FILE__, __LINE__);
-#else
-    void * newstart = malloc(newsize);
-#endif
-    bcopy(start, newstart, newsize);
-    free(start);
-    return newstart;
+	size_t oldsize;
+	void * newstart;
+
+	if (start == NULL)
+	{
+		return malloc(newsize);
+	}
+
+	oldsize = ZBLOCK_SIZE((zheader *)((char *)start - ZHEADER_SIZE)) - ZHEADER_SIZE;
+
+	// Still fits in the current block.
+	if (newsize <= oldsize)
+	{
+		return start;
+	}
+
+	newstart = malloc(newsize);
+
+	if (newstart)
+	{
+		bcopy(start, newstart, oldsize);
+		free(start);
+	}
+
+	return newstart;
 }
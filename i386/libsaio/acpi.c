@@ -33,6 +33,7 @@
 
 
 #include "platform.h"
+#include "sl.h"
 
 #include "acpi/essentials.h"				// Depends on ACPI_10_SUPPORT.
 #include "acpi/debug.h"						// Depends on the DEBUG directive.
@@ -0,0 +1,350 @@
+/*
+ * AML builder for the generated ACPI tables (see ssdt_pr_generator.h).
+ *
+ * Container objects (Scope, Device, Method, Package etc.) start with a PkgLength
+ * which size (1-4 bytes) depends on the length of the content, so a table is
+ * built in two passes of the same code: the first pass (without a buffer) only
+ * measures and records the PkgLength of each container, in the order in which
+ * they are opened, and the second pass writes the AML straight into a buffer of
+ * the exact size. Nothing gets moved around or copied afterwards.
+ *
+ * Example:
+ *
+ *	amlScope(aml, "\\_PR_.CPU0");		// Scope (\_PR.CPU0)
+ *		amlName(aml, "APSN");			// {
+ *		amlInteger(aml, 4);				//     Name (APSN, 0x04)
+ *	amlClose(aml);						// }
+ */
+
+#ifndef __LIBSAIO_ACPI_AML_GENERATOR_H
+#define __LIBSAIO_ACPI_AML_GENERATOR_H
+
+#define AML_ZERO_OP				0x00
+#define AML_ONE_OP				0x01
+#define AML_NAME_OP				0x08
+#define AML_BYTE_PREFIX			0x0A
+#define AML_WORD_PREFIX			0x0B
+#define AML_DWORD_PREFIX		0x0C
+#define AML_STRING_PREFIX		0x0D
+#define AML_SCOPE_OP			0x10
+#define AML_BUFFER_OP			0x11
+#define AML_PACKAGE_OP			0x12
+#define AML_METHOD_OP			0x14
+#define AML_DUAL_NAME_PREFIX	0x2E
+#define AML_MULTI_NAME_PREFIX	0x2F
+#define AML_ROOT_CHAR			0x5C
+#define AML_PARENT_PREFIX_CHAR	0x5E
+#define AML_RETURN_OP			0xA4
+#define AML_DEVICE_OP			0x5B82		// ExtOpPrefix (0x5B) followed by 0x82.
+#define AML_PROCESSOR_OP		0x5B83
+
+#define AML_MAX_NESTING			8
+
+
+typedef struct aml_builder
+{
+	uint8_t		* buffer;					// NULL while measuring.
+	uint32_t	offset;
+	uint32_t	* lengths;					// PkgLength values (in container order).
+	uint32_t	lengthCount;
+	uint32_t	lengthIndex;
+	uint32_t	openOffset[AML_MAX_NESTING];	// Used while measuring.
+	uint32_t	openIndex[AML_MAX_NESTING];
+	uint8_t		depth;
+} AML_BUILDER;
+
+
+//==============================================================================
+
+static inline void amlByte(AML_BUILDER * aml, uint8_t value)
+{
+	if (aml->buffer)
+	{
+		aml->buffer[aml->offset] = value;
+	}
+
+	aml->offset++;
+}
+
+
+//==============================================================================
+
+static inline void amlBytes(AML_BUILDER * aml, const void * data, uint32_t length)
+{
+	if (aml->buffer)
+	{
+		memcpy(&aml->buffer[aml->offset], data, length);
+	}
+
+	aml->offset += length;
+}
+
+
+//==============================================================================
+// Uses the shortest encoding (ZeroOp, OneOp, BytePrefix, WordPrefix or DWordPrefix).
+
+static inline void amlInteger(AML_BUILDER * aml, uint32_t value)
+{
+	if (value <= 1)
+	{
+		amlByte(aml, (value ? AML_ONE_OP : AML_ZERO_OP));
+	}
+	else if (value <= 0xFF)
+	{
+		amlByte(aml, AML_BYTE_PREFIX);
+		amlByte(aml, value);
+	}
+	else if (value <= 0xFFFF)
+	{
+		amlByte(aml, AML_WORD_PREFIX);
+		amlByte(aml, value);
+		amlByte(aml, (value >> 8));
+	}
+	else
+	{
+		amlByte(aml, AML_DWORD_PREFIX);
+		amlBytes(aml, &value, 4);			// Little endian.
+	}
+}
+
+
+//==============================================================================
+
+static inline void amlString(AML_BUILDER * aml, const char * string)
+{
+	amlByte(aml, AML_STRING_PREFIX);
+	amlBytes(aml, string, (strlen(string) + 1));
+}
+
+
+//==============================================================================
+// Writes a NameString like "APSS", "\\_PR_.CPU0" or "^^_SB_.PCI0.LPCB" where name
+// segments that are shorter than 4 characters get padded with underscores.
+
+static inline void amlNameString(AML_BUILDER * aml, const char * path)
+{
+	const char * segment;
+	int i, segmentCount = 1;
+
+	if (*path == AML_ROOT_CHAR)
+	{
+		amlByte(aml, *path++);
+	}
+	else
+	{
+		while (*path == AML_PARENT_PREFIX_CHAR)
+		{
+			amlByte(aml, *path++);
+		}
+	}
+
+	for (segment = path; *segment; segment++)
+	{
+		if (*segment == '.')
+		{
+			segmentCount++;
+		}
+	}
+
+	if (segmentCount == 2)
+	{
+		amlByte(aml, AML_DUAL_NAME_PREFIX);
+	}
+	else if (segmentCount > 2)
+	{
+		amlByte(aml, AML_MULTI_NAME_PREFIX);
+		amlByte(aml, segmentCount);
+	}
+
+	for (segment = path; segmentCount--; segment++)
+	{
+		for (i = 0; i < 4; i++)
+		{
+			amlByte(aml, ((*segment && *segment != '.') ? *segment++ : '_'));
+		}
+
+		// Ignore characters beyond the fourth (the dot is skipped by the outer loop).
+		for (; *segment && *segment != '.'; segment++);
+	}
+}
+
+
+//==============================================================================
+// Starts a container object: the opcode followed by the PkgLength (as it was
+// measured in the first pass). Must be matched with a call to amlClose.
+
+static inline void amlOpen(AML_BUILDER * aml, uint16_t opcode)
+{
+	if (opcode > 0xFF)
+	{
+		amlByte(aml, (opcode >> 8));
+	}
+
+	amlByte(aml, opcode);
+
+	if (aml->buffer)
+	{
+		uint32_t length = aml->lengths[aml->lengthIndex++];
+
+		if (length <= 0x3F)
+		{
+			amlByte(aml, length);
+		}
+		else
+		{
+			// Bits 7-6 of the lead byte hold the number of following bytes.
+			uint8_t byteCount = (length <= 0xFFF) ? 1 : (length <= 0xFFFFF) ? 2 : 3;
+
+			amlByte(aml, ((byteCount << 6) | (length & 0x0F)));
+
+			for (length >>= 4; byteCount--; length >>= 8)
+			{
+				amlByte(aml, length);
+			}
+		}
+	}
+	else if (aml->depth < AML_MAX_NESTING)
+	{
+		// Grow the list with PkgLength values (by 64 entries at a time).
+		if ((aml->lengthCount % 64) == 0)
+		{
+			aml->lengths = (uint32_t *)realloc(aml->lengths, ((aml->lengthCount + 64) * sizeof(uint32_t)));
+		}
+
+		aml->openOffset[aml->depth]	= aml->offset;
+		aml->openIndex[aml->depth]	= aml->lengthCount++;
+		aml->depth++;
+	}
+	else
+	{
+		stop("AML nesting too deep!\n");
+	}
+}
+
+
+//==============================================================================
+// Ends a container object (PkgLength values include their own bytes).
+
+static inline void amlClose(AML_BUILDER * aml)
+{
+	if (aml->buffer == NULL)
+	{
+		aml->depth--;
+
+		uint32_t length = (aml->offset - aml->openOffset[aml->depth]);
+		uint8_t byteCount = ((length + 1) <= 0x3F) ? 1 : ((length + 2) <= 0xFFF) ? 2 : ((length + 3) <= 0xFFFFF) ? 3 : 4;
+
+		aml->lengths[aml->openIndex[aml->depth]] = (length + byteCount);
+		aml->offset += byteCount;
+	}
+}
+
+
+//==============================================================================
+// Switches from measuring to writing. Returns the buffer in kernel memory.
+
+static inline uint8_t * amlAllocate(AML_BUILDER * aml)
+{
+	aml->buffer			= (uint8_t *)AllocateKernelMemory(aml->offset);
+	aml->offset			= 0;
+	aml->lengthIndex	= 0;
+
+	return aml->buffer;
+}
+
+
+//==============================================================================
+
+static inline void amlRelease(AML_BUILDER * aml)
+{
+	if (aml->lengths)
+	{
+		free(aml->lengths);
+		aml->lengths = NULL;
+	}
+}
+
+
+//==============================================================================
+// Name (name, ...) Must be followed by a data object (integer, string, package).
+
+static inline void amlName(AML_BUILDER * aml, const char * name)
+{
+	amlByte(aml, AML_NAME_OP);
+	amlNameString(aml, name);
+}
+
+
+//==============================================================================
+
+static inline void amlScope(AML_BUILDER * aml, const char * path)
+{
+	amlOpen(aml, AML_SCOPE_OP);
+	amlNameString(aml, path);
+}
+
+
+//==============================================================================
+
+static inline void amlDevice(AML_BUILDER * aml, const char * name)
+{
+	amlOpen(aml, AML_DEVICE_OP);
+	amlNameString(aml, name);
+}
+
+
+//==============================================================================
+// Method (name, argumentCount, NotSerialized)
+
+static inline void amlMethod(AML_BUILDER * aml, const char * name, uint8_t argumentCount)
+{
+	amlOpen(aml, AML_METHOD_OP);
+	amlNameString(aml, name);
+	amlByte(aml, (argumentCount & 7));
+}
+
+
+//==============================================================================
+
+static inline void amlPackage(AML_BUILDER * aml, uint8_t elementCount)
+{
+	amlOpen(aml, AML_PACKAGE_OP);
+	amlByte(aml, elementCount);
+}
+
+
+//==============================================================================
+// Buffer () { data } (complete object, no need to call amlClose).
+
+static inline void amlBuffer(AML_BUILDER * aml, const void * data, uint32_t length)
+{
+	amlOpen(aml, AML_BUFFER_OP);
+	amlInteger(aml, length);
+	amlBytes(aml, data, length);
+	amlClose(aml);
+}
+
+
+//==============================================================================
+// Processor (name, processorID, PBlkAddress, PBlkLength) { } (complete object).
+
+static inline void amlProcessor(AML_BUILDER * aml, const char * name, uint8_t processorID, uint32_t address, uint8_t length)
+{
+	amlOpen(aml, AML_PROCESSOR_OP);
+	amlNameString(aml, name);
+	amlByte(aml, processorID);
+	amlBytes(aml, &address, 4);
+	amlByte(aml, length);
+	amlClose(aml);
+}
+
+
+//==============================================================================
+// Return (...) Must be followed by a term (integer, package, name).
+
+static inline void amlReturn(AML_BUILDER * aml)
+{
+	amlByte(aml, AML_RETURN_OP);
+}
+
+#endif /* !__LIBSAIO_ACPI_AML_GENERATOR_H */
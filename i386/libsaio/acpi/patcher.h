@@ -44,80 +44,327 @@ unsigned int search64bitPattern(unsigned int aStartAddress, int aNumberOfBytes,
 #endif // VERIFY_OPREGION_GNVS_ADDRESS
 
 
-#if (LOAD_EXTRA_ACPI_TABLES && (LOAD_DSDT_TABLE_FROM_EXTRA_ACPI || LOAD_SSDT_TABLE_FROM_EXTRA_ACPI))
+#if PATCH_AML_RENAMES
+
+#define AML_RENAME(find, replace)	{ find, replace, (sizeof(find) - 1), (sizeof(replace) - 1) }
+
+typedef struct
+{
+	const char *	find;
+	const char *	replace;
+	uint8_t			findLength;
+	uint8_t			replaceLength;
+} AMLRenameRule;
+
+static const AMLRenameRule amlRenameRules[] = { AML_RENAME_RULES };
+
+#define AML_RENAME_RULE_COUNT		(sizeof(amlRenameRules) / sizeof(AMLRenameRule))
+
+static uint8_t	amlFirstRule[256];						// Index + 1 of the first rule for each leading byte (0 = none).
+static uint8_t	amlNextRule[AML_RENAME_RULE_COUNT];		// Index + 1 of the next rule with the same leading byte.
+static bool		amlRulesIndexed = false;
+
+
 //==============================================================================
+// Chains the rename rules by their leading byte, so that the table scan only
+// has to compare the rules that can match at a given offset.
 
-int loadACPITable(int tableIndex)
+static void indexAMLRenameRules(void)
 {
-	char dirSpec[48] = "";
-	long fileSize = 0;
-	void * tableAddress = (void *)kLoadAddr;
+	int i = AML_RENAME_RULE_COUNT;
 
-#if LOAD_MODEL_SPECIFIC_ACPI_DATA
-	// Example: /Extra/ACPI/DSDT-MacBookPro101.aml
-	//          0123456789 0123456789 0123456789 1
-	sprintf(dirSpec, "/Extra/ACPI/%s-%s.aml", customTables[tableIndex].name, gPlatform.CommaLessModelID);
+	bzero(amlFirstRule, sizeof(amlFirstRule));
+
+	// Walking backwards keeps rules with the same leading byte in listed order.
+	while (i--)
+	{
+		const AMLRenameRule * rule = &amlRenameRules[i];
+
+		// Renames must keep the AML length encodings intact.
+		if ((rule->findLength == 0) || (rule->findLength != rule->replaceLength))
+		{
+			_ACPI_DEBUG_DUMP("Skipping AML rename rule %d (length mismatch).\n", i);
+			continue;
+		}
+
+		amlNextRule[i] = amlFirstRule[(uint8_t)rule->find[0]];
+		amlFirstRule[(uint8_t)rule->find[0]] = (i + 1);
+	}
+
+	amlRulesIndexed = true;
+}
 
-	/*
-	 * loadBinaryData calls LoadFile (both in sys.c) to load table data into a
-	 * load buffer at kLoadAddr (defined in memory.h) and copies it into a new
-	 * allocated memory block (kLoadAddr gets overwritten by the next call).
-	 */
-	fileSize = loadBinaryData(dirSpec, &tableAddress);
 
-	if (fileSize == -1)
+//==============================================================================
+// Applies the rename rules in a single pass over the table. Factory tables are
+// left untouched; the table is copied into kernel memory on the first match, and
+// its checksum fixed afterwards. Returns the address of the table to use.
+
+void * patchAMLTable(void * table)
+{
+	ACPI_DSDT * header = (ACPI_DSDT *)table;
+
+	if (!amlRulesIndexed)
 	{
-#endif
-		// File: /Extra/ACPI/DSDT-MacBookPro101.aml not found. Try: /Extra/ACPI/dsdt.aml
-		sprintf(dirSpec, "/Extra/ACPI/%s.aml", customTables[tableIndex].name);
-		fileSize = loadBinaryData(dirSpec, &tableAddress);
-#if LOAD_MODEL_SPECIFIC_ACPI_DATA
+		indexAMLRenameRules();
 	}
-#endif
 
-	if (fileSize > 0)
+	if ((header == NULL) || (header->Length <= sizeof(ACPI_DSDT)))
 	{
-		_ACPI_DEBUG_DUMP("Loading: %s (%d bytes).\n", dirSpec, fileSize);
-		_ACPI_DEBUG_SLEEP(1);
+		return table;
+	}
 
-		// 'tableAddress' is copied into kernel memory later on (see setupACPI).
-		customTables[tableIndex].table			= tableAddress;
-		customTables[tableIndex].tableLength	= fileSize;
+	uint8_t * data = (uint8_t *)table;
+	uint32_t offset, length = header->Length;
+	int ruleIndex, renameCount = 0;
 
-#if (DEBUG_ACPI && LOAD_MODEL_SPECIFIC_ACPI_DATA)
-		// Update table name from DSDT.aml to DSDT-Macmini51.aml (DSDT example).
-		sprintf(customTables[tableIndex].fileName, gPlatform.CommaLessModelID);
+	for (offset = sizeof(ACPI_DSDT); offset < length; offset++)
+	{
+		for (ruleIndex = amlFirstRule[data[offset]]; ruleIndex; ruleIndex = amlNextRule[ruleIndex - 1])
+		{
+			const AMLRenameRule * rule = &amlRenameRules[ruleIndex - 1];
+
+			if (((offset + rule->findLength) <= length) && (memcmp(&data[offset], rule->find, rule->findLength) == 0))
+			{
+				// First match? Continue with a copy in kernel memory.
+				if (renameCount++ == 0)
+				{
+					data = (uint8_t *)AllocateKernelMemory(length);
+					memcpy(data, table, length);
+				}
+
+				memcpy(&data[offset], rule->replace, rule->findLength);
+
+				offset += (rule->findLength - 1);
+				break;
+			}
+		}
+	}
+
+	if (renameCount == 0)
+	{
+		return table;
+	}
+
+	_ACPI_DEBUG_DUMP("%d AML rename(s) in %c%c%c%c @ 0x%x\n", renameCount, data[0], data[1], data[2], data[3], data);
+
+	header = (ACPI_DSDT *)data;
+	header->Checksum = 0;
+	header->Checksum = checksum8(header, length);
+
+	return data;
+}
+#endif // PATCH_AML_RENAMES
+
+
+#if (LOAD_EXTRA_ACPI_TABLES && (LOAD_DSDT_TABLE_FROM_EXTRA_ACPI || LOAD_SSDT_TABLE_FROM_EXTRA_ACPI))
+
+#define ACPI_FILE_NAME_LEN	48
+#define MAX_SSDT_N_FILES	16			// SSDT-1.aml, SSDT-2.aml etc. (added as new tables).
+
+#define ACPI_TO_UPPER(c)	((((c) >= 'a') && ((c) <= 'z')) ? ((c) - 0x20) : (c))
+
+// The custom tables that can be loaded from /Extra/ACPI/
+static const int loadableTables[] =
+{
+#if LOAD_DSDT_TABLE_FROM_EXTRA_ACPI
+	DSDT,
+#endif
+#if LOAD_SSDT_TABLE_FROM_EXTRA_ACPI
+	SSDT, SSDT_PR, SSDT_USB, SSDT_GPU, SSDT_SATA,
+#endif
+	NONE
+};
+
+#if LOAD_SSDT_TABLE_FROM_EXTRA_ACPI
+static void *	ssdtFiles[MAX_SSDT_N_FILES];	// Kernel memory addresses (see setupACPI).
+static int		ssdtFileCount = 0;
 #endif
 
+
+//==============================================================================
+// Reads /Extra/ACPI/[fileName] straight into kernel memory, using the length of
+// the table header (which must fit in the file). Returns the table length, or
+// 0 when the file isn't usable.
+
+long loadACPITableFile(const char * fileName, uint32_t signature, void ** tableAddress)
+{
+	char dirSpec[64] = "";
+	char lastByte;
+	long length = 0;
+	ACPI_SSDT header;
+
+	sprintf(dirSpec, "/Extra/ACPI/%s", fileName);
+
+	if ((ReadFileAtOffset(dirSpec, &header, 0, sizeof(ACPI_SSDT)) == sizeof(ACPI_SSDT)) && (header.Length >= sizeof(ACPI_SSDT)))
+	{
+		// Read the last byte of the table first, so that a truncated file or a
+		// corrupt Length doesn't end up allocating (too much) kernel memory.
+		if ((*(uint32_t *)header.Signature == signature) && (ReadFileAtOffset(dirSpec, &lastByte, (header.Length - 1), 1) == 1))
+		{
+			*tableAddress = (void *)AllocateKernelMemory(header.Length);
+
+			length = (ReadFileAtOffset(dirSpec, *tableAddress, 0, header.Length) == (long)header.Length) ? header.Length : 0;
+		}
+	}
+	else if ((length = LoadFile(dirSpec)) >= (long)sizeof(ACPI_SSDT)) // File systems without fs_readfile.
+	{
+		ACPI_SSDT * table = (ACPI_SSDT *)kLoadAddr;
+
+		if ((*(uint32_t *)table->Signature == signature) && (table->Length >= sizeof(ACPI_SSDT)) && (table->Length <= (uint32_t)length))
+		{
+			length = table->Length;
+			*tableAddress = (void *)AllocateKernelMemory(length);
+			memcpy(*tableAddress, (void *)kLoadAddr, length);
+		}
+		else
+		{
+			length = 0;
+		}
+	}
+
+	if (length < (long)sizeof(ACPI_SSDT))
+	{
+		_ACPI_DEBUG_DUMP("Error: %s not loaded.\n", dirSpec);
+
 		return 0;
 	}
 
-	_ACPI_DEBUG_DUMP("Error: File %s not found.)\n", dirSpec);
-	_ACPI_DEBUG_SLEEP(5);
+	_ACPI_DEBUG_DUMP("Loading: %s (%d bytes).\n", dirSpec, length);
 
-	return -1;
+	return length;
 }
 
 
 //==============================================================================
+// Walks through /Extra/ACPI/ once, matches the .aml files against the custom
+// tables ([name]-[model].aml wins over [name].aml) and loads the matches.
 
 void loadACPITables(void)
 {
-	// DHP: We might want to change this and walk through the /Extra/ACPI/ folder for target tabels.
+	char baseName[ACPI_FILE_NAME_LEN];
+	char fileNames[SSDT_USB + 1][ACPI_FILE_NAME_LEN];
+	bool modelSpecific[SSDT_USB + 1];
 
-#if LOAD_DSDT_TABLE_FROM_EXTRA_ACPI
-	loadACPITable(DSDT);
-#endif // LOAD_DSDT_TABLE_FROM_EXTRA_ACPI
+	const char * name;
+	long flags, time, index = 0;
+	int i, type, length;
+	void * tableAddress = NULL;
 
 #if LOAD_SSDT_TABLE_FROM_EXTRA_ACPI
-	// loadACPITable(APIC); Table load example!
-	loadACPITable(SSDT);
-	loadACPITable(SSDT_PR);	// Overrides STATIC_SSDT_PR_TABLE_DATA / AUTOMATIC_SSDT_PR_CREATION when found!
-	loadACPITable(SSDT_USB);
-	loadACPITable(SSDT_GPU);
-	loadACPITable(SSDT_SATA);
-#endif	// LOAD_SSDT_TABLE_FROM_EXTRA_ACPI
+	char ssdtFileNames[MAX_SSDT_N_FILES][ACPI_FILE_NAME_LEN];
+	int ssdtFileNameCount = 0;
+#endif
+
+#if LOAD_MODEL_SPECIFIC_ACPI_DATA
+	char modelID[ACPI_FILE_NAME_LEN];
+
+	strlcpy(modelID, gPlatform.CommaLessModelID, sizeof(modelID));
+
+	for (i = 0; modelID[i]; i++)
+	{
+		modelID[i] = ACPI_TO_UPPER(modelID[i]);
+	}
+#endif
+
+	bzero(fileNames, sizeof(fileNames));
+	bzero(modelSpecific, sizeof(modelSpecific));
+
+	while (GetDirEntry("/Extra/ACPI/", &index, &name, &flags, &time) == 0)
+	{
+		length = strlen(name);
 
+		if (((flags & kFileTypeMask) != kFileTypeFlat) || (length < 5) || (length >= ACPI_FILE_NAME_LEN))
+		{
+			continue;
+		}
+
+		// Upper case copy of the name (HFS+ file names are case insensitive).
+		for (i = 0; i <= length; i++)
+		{
+			baseName[i] = ACPI_TO_UPPER(name[i]);
+		}
+
+		if (strcmp(&baseName[length - 4], ".AML") != 0)
+		{
+			continue;
+		}
+
+		baseName[length - 4] = '\0';
+
+		for (i = 0; (type = loadableTables[i]) != NONE; i++)
+		{
+			int nameLength = strlen(customTables[type].name);
+
+			if (strncmp(baseName, customTables[type].name, nameLength) == 0)
+			{
+				// Example: /Extra/ACPI/SSDT.aml
+				if (baseName[nameLength] == '\0' && !modelSpecific[type])
+				{
+					strcpy(fileNames[type], name);
+					break;
+				}
+#if LOAD_MODEL_SPECIFIC_ACPI_DATA
+				// Example: /Extra/ACPI/SSDT-MacBookPro101.aml
+				if (baseName[nameLength] == '-' && strcmp(&baseName[nameLength + 1], modelID) == 0)
+				{
+					strcpy(fileNames[type], name);
+					modelSpecific[type] = true;
+					break;
+				}
+#endif
+			}
+		}
+
+#if LOAD_SSDT_TABLE_FROM_EXTRA_ACPI
+		// Example: /Extra/ACPI/SSDT-1.aml
+		if ((type == NONE) && (strncmp(baseName, "SSDT-", 5) == 0) && baseName[5] && (ssdtFileNameCount < MAX_SSDT_N_FILES))
+		{
+			for (i = 5; (baseName[i] >= '0') && (baseName[i] <= '9'); i++);
+
+			if (baseName[i] == '\0')
+			{
+				strcpy(ssdtFileNames[ssdtFileNameCount++], name);
+			}
+		}
+#endif
+	}
+
+	// Now load the matched files back-to-back.
+	for (i = 0; (type = loadableTables[i]) != NONE; i++)
+	{
+		if (fileNames[type][0] == '\0')
+		{
+			continue;
+		}
+
+		length = loadACPITableFile(fileNames[type], (type == DSDT) ? DSDT_TABLE_SIGNATURE : SSDT_TABLE_SIGNATURE, &tableAddress);
+
+		if (length)
+		{
+			// Already in kernel memory (see setupACPI).
+			customTables[type].table		= tableAddress;
+			customTables[type].tableAddress	= tableAddress;
+			customTables[type].tableLength	= length;
+			customTables[type].loaded		= false;
+
+#if (DEBUG_ACPI && LOAD_MODEL_SPECIFIC_ACPI_DATA)
+			strlcpy(customTables[type].fileName, fileNames[type], sizeof(customTables[type].fileName));
+#endif
+		}
+	}
+
+#if LOAD_SSDT_TABLE_FROM_EXTRA_ACPI
+	for (i = 0; i < ssdtFileNameCount; i++)
+	{
+		if (loadACPITableFile(ssdtFileNames[i], SSDT_TABLE_SIGNATURE, &tableAddress))
+		{
+			ssdtFiles[ssdtFileCount++] = tableAddress;
+		}
+	}
+#endif
+
+	_ACPI_DEBUG_SLEEP(1);
 }
 #endif // LOAD_EXTRA_ACPI_TABLES && (LOAD_DSDT_TABLE_FROM_EXTRA_ACPI || LOAD_SSDT_TABLE_FROM_EXTRA_ACPI)
 
@@ -366,6 +613,22 @@ bool patchFACPTable(ENTRIES * xsdtEntries, int tableIndex, int dropOffset)
 
 	customTables[FACS].table = NULL;
 #endif	// STATIC_FACS_TABLE_INJECTION
+
+#if PATCH_AML_RENAMES
+	// Apply the AML rename rules to the DSDT that is used from here on.
+	uint32_t dsdtAddress = patchedFADT->DSDT;
+
+	if (dsdtAddress)
+	{
+		patchedFADT->DSDT = (uint32_t)patchAMLTable((void *)dsdtAddress);
+	}
+
+	if (patchedFADT->X_DSDT)
+	{
+		patchedFADT->X_DSDT = (patchedFADT->X_DSDT == dsdtAddress) ? patchedFADT->DSDT : (uint32_t)patchAMLTable((void *)(uint32_t)patchedFADT->X_DSDT);
+	}
+#endif	// PATCH_AML_RENAMES
+
 	patchedFADT->Checksum = 0;
 	patchedFADT->Checksum = checksum8(patchedFADT, sizeof(ACPI_FADT));
 		
@@ -401,14 +664,18 @@ void setupACPI(void)
 
 	// _ACPI_DUMP_XSDT_TABLE(factoryXSDT, "Factory");
 
-#if AUTOMATIC_SSDT_PR_CREATION
-	generateSSDT_PR();
-#endif	// AUTOMATIC_SSDT_PR_CREATION
-
 #if LOAD_EXTRA_ACPI_TABLES
 	loadACPITables();
 #endif	// LOAD_EXTRA_ACPI_TABLES
 
+#if AUTOMATIC_SSDT_PR_CREATION
+	// /Extra/ACPI/SSDT_PR.aml takes precedence over the generated table.
+	if (customTables[SSDT_PR].tableAddress == 0)
+	{
+		generateSSDT_PR();
+	}
+#endif	// AUTOMATIC_SSDT_PR_CREATION
+
 	_ACPI_DEBUG_DUMP("\n");
 
 #if DROP_SELECTED_SSDT_TABLE
@@ -423,14 +690,18 @@ void setupACPI(void)
 		{
 			_ACPI_DEBUG_DUMP("customTable[%2d] %9s length: %d\n", cti, customTables[cti].name, customTables[cti].tableLength);
 
-			customTables[cti].tableAddress = (void *)AllocateKernelMemory(customTables[cti].tableLength);
-			memcpy((void *)customTables[cti].tableAddress, (void *)customTables[cti].table, customTables[cti].tableLength);
-			
-			// Did we load this table from file?
-			if (customTables[cti].loaded)
+			// Tables from /Extra/ACPI/ are loaded straight into kernel memory.
+			if (customTables[cti].tableAddress == 0)
 			{
-				// Yes. Return previously allocated memory.
-				free(customTables[cti].table);
+				customTables[cti].tableAddress = (void *)AllocateKernelMemory(customTables[cti].tableLength);
+				memcpy((void *)customTables[cti].tableAddress, (void *)customTables[cti].table, customTables[cti].tableLength);
+
+				// Did we load this table from file?
+				if (customTables[cti].loaded)
+				{
+					// Yes. Return previously allocated memory.
+					free(customTables[cti].table);
+				}
 			}
 		}
 		else
@@ -446,40 +717,36 @@ void setupACPI(void)
 	/*
 	 * Main loop with some basic validation checks.
 	 *
-	 * Note: 196 offers space for twenty 64-bit table addresses.
-	 *       196 - 36 = 160 / 8 = 20 tables.
+	 * Note: The factory XSDT is no longer patched in place. Its entries, and the
+	 *       custom tables, are collected in a table set (xsdtEntries) that is
+	 *       written to a new XSDT of the required size when we're done.
 	 */
 
-	if (factoryXSDT && factoryXSDT->Length < 196 && VALID_ADDRESS(factoryRSDP, factoryXSDT))
+	if (factoryXSDT && factoryXSDT->Length >= sizeof(ACPI_XSDT) && VALID_ADDRESS(factoryRSDP, factoryXSDT))
 	{
 		int i, dropOffset = 0;
 
-		// Creates a copy of the RSDP aka our to-be-patched-table.
-		ACPI_RSDP * patchedRSDP = (ACPI_RSDP *) AllocateKernelMemory(sizeof(ACPI_RSDP));
-		memcpy(patchedRSDP, factoryRSDP, RSDP_LENGTH);
-
-		// Keep address for efi.c
-		gPlatform.ACPI.BaseAddress = (uint32_t)patchedRSDP;
+		int entryCount = (factoryXSDT->Length - sizeof(ACPI_XSDT)) / ADDRESS_WIDTH;
 
-		// Creates a copy of the XSDP aka our to-be-patched-table.
-		ACPI_XSDT * patchedXSDT = (ACPI_XSDT *) AllocateKernelMemory(factoryXSDT->Length);
-		memcpy(patchedXSDT, factoryXSDT, factoryXSDT->Length);
+		int customTableCount = (sizeof(customTables) / sizeof(ACPITable));
 
-		// Pseudo code to fake Apple ID's.
-		_ACPI_SET_APPLE_OEMID(patchedRSDP);
-		_ACPI_SET_APPLE_OEMID(patchedXSDT);
-		_ACPI_SET_APPLE_OEMTargetID(patchedXSDT);
+#if (LOAD_EXTRA_ACPI_TABLES && LOAD_SSDT_TABLE_FROM_EXTRA_ACPI)
+		customTableCount += ssdtFileCount;
+#endif
 
-		int entryCount = (patchedXSDT->Length - sizeof(ACPI_XSDT)) / ADDRESS_WIDTH;
+		// Room for all factory and custom tables.
+		ENTRIES * xsdtEntries = (ENTRIES *) malloc((entryCount + customTableCount) * sizeof(ENTRIES));
 
-		// ACPI 1.0 -> ACPI 2.0 (or initializes patchedRSDP->XsdtAddress).
-		updateACPITableData(patchedRSDP, patchedXSDT, entryCount);
+		if (xsdtEntries == NULL)
+		{
+			// Fall back to the factory tables (like without PATCH_ACPI_TABLE_DATA).
+			gPlatform.ACPI.BaseAddress = (uint32_t)factoryRSDP;
 
-		_ACPI_DUMP_RSDP_TABLE(patchedRSDP, "Modified");
-		_ACPI_DUMP_XSDT_TABLE(patchedXSDT, "Modified");
+			error("setupACPI(): out of memory, factory ACPI tables used.\n");
+			return;
+		}
 
-		// Gives us a 32/64-bit pointer to the table entries (depends on compiler directives).
-		ENTRIES * xsdtEntries = (ENTRIES *) (patchedXSDT + 1);
+		memcpy(xsdtEntries, (void *)(factoryXSDT + 1), (entryCount * ADDRESS_WIDTH));
 
 		_ACPI_DEBUG_DUMP("\nWe have %d entries to work with\n", entryCount);
 
@@ -593,55 +860,69 @@ void setupACPI(void)
 
 		_ACPI_DEBUG_DUMP("Dropped table count: %d\n", dropOffset);
 
-		// printf("size: %d\n", sizeof(customTables) / sizeof(ACPITable)); // 308
-
 		i = (entryCount - dropOffset);
-		int newTableEntries = 0;
 
 		// Now wade through the custom table entries to see if they have been assigned already.
-		for (cti = 0; cti < 14; cti++)
+		for (cti = 0; cti < (int)(sizeof(customTables) / sizeof(ACPITable)); cti++)
 		{
 			// We need an address so check it.
 			if (customTables[cti].table)
 			{
-				// Do we have a previously dropped table entry available for use?
-				if (dropOffset)
-				{
-					_ACPI_DEBUG_DUMP("Using void XSDT entry[%d] for table: %s.\n", dropOffset, customTables[cti].name);
+				_ACPI_DEBUG_DUMP("Adding XSDT entry[%d] for table: %s.\n", i, customTables[cti].name);
 
-					// Yes. Reassigning XSDT table entry.
-					xsdtEntries[i++] = (uint32_t)customTables[cti].tableAddress;
+				xsdtEntries[i++] = (uint32_t)customTables[cti].tableAddress;
 
-					customTables[cti].table = NULL;
-
-					// One free spot filled up.
-					dropOffset--;
-				}
-				else // Adding new entries.
-				{
-					_ACPI_DEBUG_DUMP("Adding new XSDT entry for table: %s.\n", customTables[cti].name);
-
-					// Expand entry table.
-					xsdtEntries[i++] = (uint32_t)customTables[cti].tableAddress;
+				customTables[cti].table = NULL;
+			}
+		}
 
-					newTableEntries++;
+#if (LOAD_EXTRA_ACPI_TABLES && LOAD_SSDT_TABLE_FROM_EXTRA_ACPI)
+		// Followed by the SSDT-N.aml files from /Extra/ACPI/
+		for (cti = 0; cti < ssdtFileCount; cti++)
+		{
+			xsdtEntries[i++] = (uint32_t)ssdtFiles[cti];
+		}
+#endif
 
-					// Adjust table length.
-					patchedXSDT->Length += ADDRESS_WIDTH;
-				}
+#if PATCH_AML_RENAMES
+		// Apply the AML rename rules to the SSDT tables (one pass per table).
+		for (cti = 0; cti < i; cti++)
+		{
+			if (*(uint32_t *)(uint32_t)xsdtEntries[cti] == SSDT_TABLE_SIGNATURE)
+			{
+				xsdtEntries[cti] = (uint32_t)patchAMLTable((void *)(uint32_t)xsdtEntries[cti]);
 			}
 		}
+#endif
 
-		_ACPI_DEBUG_DUMP("patchedXSDT->Length (current): %d\n", patchedXSDT->Length);
+		// Creates a copy of the RSDP aka our to-be-patched-table.
+		ACPI_RSDP * patchedRSDP = (ACPI_RSDP *) AllocateKernelMemory(sizeof(ACPI_RSDP));
+		memcpy(patchedRSDP, factoryRSDP, RSDP_LENGTH);
 
-		// Did we drop tables without using them for new tables?
-		if (dropOffset)
-		{
-			// Yes, fix length.
-			patchedXSDT->Length -= (ADDRESS_WIDTH * dropOffset);
+		// Keep address for efi.c
+		gPlatform.ACPI.BaseAddress = (uint32_t)patchedRSDP;
 
-			_ACPI_DEBUG_DUMP("patchedXSDT->Length (changed): %d/%d\n", patchedXSDT->Length, (patchedXSDT->Length / ADDRESS_WIDTH));
-		}
+		// The new XSDP; factory header followed by the table set.
+		ACPI_XSDT * patchedXSDT = (ACPI_XSDT *) AllocateKernelMemory(sizeof(ACPI_XSDT) + (i * ADDRESS_WIDTH));
+		memcpy(patchedXSDT, factoryXSDT, sizeof(ACPI_XSDT));
+		memcpy((void *)(patchedXSDT + 1), xsdtEntries, (i * ADDRESS_WIDTH));
+
+		patchedXSDT->Length = (sizeof(ACPI_XSDT) + (i * ADDRESS_WIDTH));
+
+		free(xsdtEntries);
+
+		// Pseudo code to fake Apple ID's.
+		_ACPI_SET_APPLE_OEMID(patchedRSDP);
+		_ACPI_SET_APPLE_OEMID(patchedXSDT);
+		_ACPI_SET_APPLE_OEMTargetID(patchedXSDT);
+
+		// ACPI 1.0 -> ACPI 2.0 (or initializes patchedRSDP->XsdtAddress).
+		updateACPITableData(patchedRSDP, patchedXSDT, i);
+
+		_ACPI_DUMP_RSDP_TABLE(patchedRSDP, "Modified");
+		_ACPI_DUMP_XSDT_TABLE(patchedXSDT, "Modified");
+
+		_ACPI_DEBUG_DUMP("patchedXSDT->Length: %d (%d entries)\n", patchedXSDT->Length, i);
 
 		_ACPI_DEBUG_DUMP("\nRecalculating checksums / ");
 
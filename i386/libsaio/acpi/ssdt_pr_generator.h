@@ -10,6 +10,8 @@
  *			- Single turbo state support (TODO list) implemented by DHP.
  *			- Device (SBUS) injection added (required for AICPUPM) by DHP.
  *			- New global directive (AUTOMATIC_SSDT_PR_CREATION) added by DHP.
+ *			- AML is now generated with aml_generator.h (any number of logical CPUs).
+ *			- Method (_PSS) and Method (_CST) injection added (AUTOMATIC_SSDT_PR_CREATION & 8).
  *
  *	Credits:
  *			- Master Chief for his ongoing hands-on ACPI table lessons.
@@ -24,7 +26,8 @@
  *
  *	Notes:
  *
- *			- We <i>only</i> want to support Sandy Bridge processors.
+ *			- Written for Sandy Bridge processors, but the generated tables are
+ *			  not limited by the number of cores/threads or P-States anymore.
  *
  *			- Wrong UEFI settings will lead to:
  *				AppleIntelCPUPowerManagement: Turbo Ratio 19999 / 1BBBA (?)
@@ -34,6 +37,7 @@
 
 
 #include "cpu/proc_reg.h"
+#include "aml_generator.h"
 
 //------------------------------------------------------------------------------
 // Adding two local directives, for backward compatibility, but we prefer that
@@ -52,162 +56,376 @@
 	#define AUTOMATIC_DEVICE_SBUS_CREATION		1
 #endif
 
+#if AUTOMATIC_SSDT_PR_CREATION & 8
+	#define AUTOMATIC_PSS_CST_METHODS_CREATION	1
+#endif
+
+
+//------------------------------------------------------------------------------
+// This directive enables you to use a custom name (CPUn) instead of the
+// factory name (P00n) for processor definition blocks (think namespace).
+// Processors 16 and up use two hex digits (CP10, CP11 and so on).
+//------------------------------------------------------------------------------
+
+#define _CPU_LABEL_REPLACEMENT	"CPU"
+
+#define MAX_NUMBER_OF_THREADS	255			// Processor ID's are 1 - 255.
+
+
+//------------------------------------------------------------------------------
+// Our pre-defined AML data.
+
+static uint8_t SSDT_PM_HEADER[] =
+{
+	/* 0000 */	0x53, 0x53, 0x44, 0x54, 0x24, 0x00, 0x00, 0x00,
+	/* 0008 */	0x01, 0xFF, 0x41, 0x50, 0x50, 0x4C, 0x45, 0x20,
+	/* 0010 */	0x43, 0x70, 0x75, 0x50, 0x6D, 0x00, 0x00, 0x00,
+	/* 0018 */	0x00, 0x10, 0x00, 0x00, 0x49, 0x4E, 0x54, 0x4C,
+	/* 0020 */	0x16, 0x03, 0x11, 0x20
+};
+
+#if AUTOMATIC_P_STATES_CREATION
+typedef struct p_state
+{
+	uint16_t	Frequency;
+	uint32_t	Power;
+	uint16_t	Ratio;
+} P_STATE;
+
+typedef struct c_state
+{
+	uint8_t		Type;
+	uint8_t		AccessSize;
+	uint8_t		Address;						// Register (FFixedHW, 0x01, 0x02, Address, AccessSize)
+	uint16_t	Latency;
+	uint16_t	Power;
+} C_STATE;
+
+static const C_STATE cStates[] =
+{
+	{ 1, 0x01, 0x00, 0x03, 0x03E8 },			// C1
+	{ 3, 0x03, 0x10, 0xCD, 0x01F4 },			// C3
+	{ 6, 0x03, 0x20, 0xF5, 0x015E },			// C6
+	{ 7, 0x03, 0x30, 0xF5, 0x00C8 }				// C7
+};
+
+#define NUMBER_OF_C_STATES		(sizeof(cStates) / sizeof(C_STATE))
+#endif	// AUTOMATIC_P_STATES_CREATION
 
+
+#if (AUTOMATIC_PROCESSOR_BLOCK_CREATION || AUTOMATIC_P_STATES_CREATION)
 //==============================================================================
+// Writes the name of processor 'cpu' (CPU0 - CPUF, CP10 - CPFE) into 'name'.
 
-void generateSSDT_PR(void)
+static void getProcessorName(char * name, uint32_t cpu)
 {
-	//--------------------------------------------------------------------------
-	// This directive enables you to use a custom name (CPUn) instead of the 
-	// factory name (P00n) for processor definition blocks (think namespace).
-	//--------------------------------------------------------------------------
-	
-#define _CPU_LABEL_REPLACEMENT	0x43, 0x50, 0x55, 0x30	// CPU0
+	const char * hexDigits = "0123456789ABCDEF";
 
-	//--------------------------------------------------------------------------
-	// Our pre-defined AML data blocks.
+	strlcpy(name, _CPU_LABEL_REPLACEMENT, 5);
 
-	uint8_t SSDT_PM_HEADER[] =
+	if (cpu > 15)
 	{
-		/* 0000 */	0x53, 0x53, 0x44, 0x54, 0x24, 0x00, 0x00, 0x00, 
-		/* 0008 */	0x01, 0xFF, 0x41, 0x50, 0x50, 0x4C, 0x45, 0x20, 
-		/* 0010 */	0x43, 0x70, 0x75, 0x50, 0x6D, 0x00, 0x00, 0x00, 
-		/* 0018 */	0x00, 0x10, 0x00, 0x00, 0x49, 0x4E, 0x54, 0x4C, 
-		/* 0020 */	0x16, 0x03, 0x11, 0x20
-	};
-	
-#if AUTOMATIC_DEVICE_SBUS_CREATION
-	uint8_t SCOPE_PCI0_SBUS[] =						// Scope (\_SB.PCI0) { ... }
-	{
-		/* 0000 */	0x10, 0x46, 0x05, 0x5C, 0x2E, 0x5F, 0x53, 0x42, 
-		/* 0008 */	0x5F, 0x50, 0x43, 0x49, 0x30, 0x5B, 0x82, 0x48, 
-		/* 0010 */	0x04, 0x53, 0x42, 0x55, 0x53, 0x08, 0x5F, 0x41, 
-		/* 0018 */	0x44, 0x52, 0x0C, 0x03, 0x00, 0x1F, 0x00, 0x5B, 
-		/* 0020 */	0x82, 0x36, 0x42, 0x55, 0x53, 0x30, 0x08, 0x5F, 
-		/* 0028 */	0x43, 0x49, 0x44, 0x0D, 0x73, 0x6D, 0x62, 0x75, 
-		/* 0030 */	0x73, 0x00, 0x08, 0x5F, 0x41, 0x44, 0x52, 0x00, 
-		/* 0038 */	0x5B, 0x82, 0x1D, 0x44, 0x56, 0x4C, 0x30, 0x08, 
-		/* 0040 */	0x5F, 0x41, 0x44, 0x52, 0x0A, 0x57, 0x08, 0x5F, 
-		/* 0048 */	0x43, 0x49, 0x44, 0x0D, 0x64, 0x69, 0x61, 0x67, 
-		/* 0050 */	0x73, 0x76, 0x61, 0x75, 0x6C, 0x74, 0x00
-	};
+		name[2] = hexDigits[(cpu >> 4) & 0x0F];
+	}
+
+	name[3] = hexDigits[cpu & 0x0F];
+	name[4] = '\0';
+}
 #endif
 
-#if AUTOMATIC_PROCESSOR_BLOCK_CREATION
-	uint8_t SCOPE_PR[] =							// Scope (\_PR_) { }
-	{
-		/* 0000 */	0x10, 0xFF, 0xFF, 0x5C, 0x5F, 0x50, 0x52, 0x5F
 
-		/* 0000 * /	0x10, 0xFF, 0xFF, 0x5C, 0x2E, 0x5F, 0x50, 0x52
-		/ *0008 * /	0x5F */
-	};
+#if AUTOMATIC_P_STATES_CREATION
+//==============================================================================
+// Adds the C-State packages that are used by Method (ACST) and Method (_CST):
+//
+//	Package (0x04)
+//	{
+//		ResourceTemplate ()
+//		{
+//			Register (FFixedHW, 0x01, 0x02, 0x0000000000000000, 0x01, )
+//		},
+//
+//		One,
+//		0x03,
+//		0x03E8
+//	},
+//	../..
+
+static void addCStatePackages(AML_BUILDER * aml)
+{
+	uint8_t i;
 
-	uint8_t PROCESSOR_DEF_BLOCK[] =
+	// Generic Register Descriptor followed by an End Tag.
+	uint8_t resourceTemplate[] =
 	{
-		/* 0000 */	0x5B, 0x83, 0x0B, _CPU_LABEL_REPLACEMENT, 0xFF, 
-		/* 0008 */	0x10, 0x04, 0x00, 0x00, 0x06
+		/* 0000 */	0x82, 0x0C, 0x00, 0x7F, 0x01, 0x02, 0xFF, 0xFF,
+		/* 0008 */	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x79,
+		/* 0010 */	0x00
 	};
-	
-#define INDEX_OF_PROCESSOR_CPU_ID	0x06			// Points to 0x30 in _CPU_LABEL_REPLACEMENT
-#define INDEX_OF_PROCESSOR_NUMBER	0x07			// Points to 0x01
-	
-#endif	// AUTOMATIC_PROCESSOR_BLOCK_CREATION
 
-#define INDEX_OF_SCOPE_LENGTH		0x01		// Points to 0xFF 0xFF in SCOPE_PR_CPU0
+	#define INDEX_OF_ACCESS_SIZE	0x06		// Points to the first 0xFF in resourceTemplate
+	#define INDEX_OF_ADDRESS		0x07		// Points to the second 0xFF in resourceTemplate
 
+	for (i = 0; i < NUMBER_OF_C_STATES; i++)
+	{
+		resourceTemplate[INDEX_OF_ACCESS_SIZE]	= cStates[i].AccessSize;
+		resourceTemplate[INDEX_OF_ADDRESS]		= cStates[i].Address;
+
+		amlPackage(aml, 4);
+		amlBuffer(aml, resourceTemplate, sizeof(resourceTemplate));
+		amlInteger(aml, cStates[i].Type);
+		amlInteger(aml, cStates[i].Latency);
+		amlInteger(aml, cStates[i].Power);
+		amlClose(aml);
+	}
+}
+#endif	// AUTOMATIC_P_STATES_CREATION
+
+
+//==============================================================================
+// Called twice by generateSSDT_PR(); first to measure and then to write the AML.
+
+#if AUTOMATIC_P_STATES_CREATION
+static void addSSDT_PR(AML_BUILDER * aml, uint32_t numberOfThreads, P_STATE * pStates, uint8_t numberOfPStates)
+#else
+static void addSSDT_PR(AML_BUILDER * aml, uint32_t numberOfThreads)
+#endif
+{
+#if (AUTOMATIC_PROCESSOR_BLOCK_CREATION || AUTOMATIC_P_STATES_CREATION)
+	char name[5];
+	uint32_t cpu;
+#endif
 #if AUTOMATIC_P_STATES_CREATION
+	char path[12];
+#endif
 
-	uint8_t SCOPE_PR_CPU0[] =						// Scope (\_PR.CPU0) { }
-	{
-		/* 0000 */	0x10, 0xFF, 0xFF, 0x5C, 0x2E, 0x5F, 0x50, 0x52,
-		/* 0008 */	0x5F, _CPU_LABEL_REPLACEMENT
-	};
+	amlBytes(aml, SSDT_PM_HEADER, sizeof(SSDT_PM_HEADER));
 
-	uint8_t NAME_APSN[] =							// Name (APSN, 0xFF)
-	{
-		/* 0000 */	0x08, 0x41, 0x50, 0x53, 0x4E, 0x0A, 0xFF
-	};
+#if AUTOMATIC_DEVICE_SBUS_CREATION					// See: config/settings.h
+	//--------------------------------------------------------------------------
+	// Here we add the following AML code:
+	//
+	//    Scope (\_SB.PCI0)
+	//    {
+	//        Device (SBUS)
+	//        {
+	//            Name (_ADR, 0x001F0003)
+	//            Device (BUS0)
+	//            {
+	//                Name (_CID, "smbus")
+	//                Name (_ADR, Zero)
+	//                Device (DVL0)
+	//                {
+	//                    Name (_ADR, 0x57)
+	//                    Name (_CID, "diagsvault")
+	//                }
+	//            }
+	//        }
+	//    }
 
-	#define INDEX_OF_APSN				0x06		// Points to 0xFF in NAME_APSN
+	amlScope(aml, "\\_SB_.PCI0");
+		amlDevice(aml, "SBUS");
+			amlName(aml, "_ADR");
+			amlInteger(aml, 0x001F0003);
+			amlDevice(aml, "BUS0");
+				amlName(aml, "_CID");
+				amlString(aml, "smbus");
+				amlName(aml, "_ADR");
+				amlInteger(aml, 0);
+				amlDevice(aml, "DVL0");
+					amlName(aml, "_ADR");
+					amlInteger(aml, 0x57);
+					amlName(aml, "_CID");
+					amlString(aml, "diagsvault");
+				amlClose(aml);
+			amlClose(aml);
+		amlClose(aml);
+	amlClose(aml);
+#endif	// AUTOMATIC_DEVICE_SBUS_CREATION
 
-	uint8_t NAME_APSS[] =							// Name (APSS, Package(0xFF) { })
-	{
-		/* 0000 */	0x08, 0x41, 0x50, 0x53, 0x53, 0x12, 0xFF, 0xFF, 
-		/* 0008 */	0xFF
-	};
+#if AUTOMATIC_PROCESSOR_BLOCK_CREATION				// See: config/settings.h
+	//--------------------------------------------------------------------------
+	// Here we add the following AML code:
+	//
+	//	Scope (\_PR)
+	//	{
+	//        Processor (CPUn, 0x0n, 0x00000410, 0x06) {}
+	//	      ...
+
+	/*
+	 * What we do here is to inject the Processor declaration blocks so that
+	 * you don't have to add them to your DSDT anymore. This way you can boot
+	 * a new Sandy Bridge setup, with AICPUPM loaded, without even having a
+	 * (modified) DSDT for it.
+	 *
+	 * Does this sound familiar to you: "<i>I have this and that board and I
+	 * wanted to know if your DSDT will work for my board</i>"?
+	 *
+	 * Right. Well. This concept might not be new. In fact it isn't, MC did this
+	 * for his P5K PRO in 2009 already, but it will be a lot more portable.
+	 *
+	 * Let's stop messing with zillions of different (Sandy Bridge) DSDT's and
+	 * just use a Secondary System Device Table instead, because this is exactly
+	 * why that was being developed... so let's use it to our advantage ;)
+	 */
 
-	#define INDEX_OF_PACKAGE_LENGTH		0x06		// Points to 0xFF 0xFF in NAME_APSS
-	#define INDEX_OF_P_STATES			0x08		// Points to 0xFF (first one) in NAME_APSS
+	amlScope(aml, "\\_PR_");
 
-	uint8_t PACKAGE_P_STATE[] =						// Package(0x06) { ... }
-	{
-		/* 0000 */	0x12, 0x14, 0x06, 0x0B, 0x00, 0x00, 0x0C, 0x00, 
-		/* 0008 */	0x00, 0x00, 0x00, 0x0A, 0x0A, 0x0A, 0x0A, 0x0B, 
-		/* 0010 */	0x00, 0x00, 0x0B, 0x00, 0x00
-	};
-	
-	uint8_t METHOD_ACST[] =							// Method (ACST, Package(NN) { ... }
+	for (cpu = 0; cpu < numberOfThreads; cpu++)
 	{
-		/* 0000 */	0x14, 0x49, 0x08, 0x41, 0x43, 0x53, 0x54, 0x00,
-		/* 0008 */	0xA4, 0x12, 0x40, 0x08, 0x06, 0x01, 0x0A, 0x04, 
-		/* 0010 */	0x12, 0x1D, 0x04, 0x11, 0x14, 0x0A, 0x11, 0x82, 
-		/* 0018 */	0x0C, 0x00, 0x7F, 0x01, 0x02, 0x01, 0x00, 0x00, 
-		/* 0020 */	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x79, 0x00, 
-		/* 0028 */	0x01, 0x0A, 0x03, 0x0B, 0xE8, 0x03, 0x12, 0x1E, 
-		/* 0030 */	0x04, 0x11, 0x14, 0x0A, 0x11, 0x82, 0x0C, 0x00, 
-		/* 0038 */	0x7F, 0x01, 0x02, 0x03, 0x10, 0x00, 0x00, 0x00, 
-		/* 0040 */	0x00, 0x00, 0x00, 0x00, 0x79, 0x00, 0x0A, 0x03, 
-		/* 0048 */	0x0A, 0xCD, 0x0B, 0xF4, 0x01, 0x12, 0x1E, 0x04, 
-		/* 0050 */	0x11, 0x14, 0x0A, 0x11, 0x82, 0x0C, 0x00, 0x7F, 
-		/* 0058 */	0x01, 0x02, 0x03, 0x20, 0x00, 0x00, 0x00, 0x00, 
-		/* 0060 */	0x00, 0x00, 0x00, 0x79, 0x00, 0x0A, 0x06, 0x0A, 
-		/* 0068 */	0xF5, 0x0B, 0x5E, 0x01, 0x12, 0x1D, 0x04, 0x11, 
-		/* 0070 */	0x14, 0x0A, 0x11, 0x82, 0x0C, 0x00, 0x7F, 0x01, 
-		/* 0078 */	0x02, 0x03, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 
-		/* 0080 */	0x00, 0x00, 0x79, 0x00, 0x0A, 0x07, 0x0A, 0xF5, 
-		/* 0088 */	0x0A, 0xC8
-	};
-	
-	uint8_t SCOPE_CPU_N[] =							// Scope (\_PR.CPUn) { ... }
+		getProcessorName(name, cpu);
+		amlProcessor(aml, name, (cpu + 1), 0x00000410, 0x06);
+	}
+
+	amlClose(aml);
+#endif	// AUTOMATIC_PROCESSOR_BLOCK_CREATION
+
+#if AUTOMATIC_P_STATES_CREATION
+	uint8_t i;
+
+	//--------------------------------------------------------------------------
+	// Here we add the following AML code:
+	//
+	//	Scope (\_PR.CPU0)
+	//	{
+	//		Name (APSN, NN)
+	//		Name (APSS, Package (NN)
+	//		{
+	//			Package (0x06) { 0xNNNN, 0xNNNN, 10, 10, 0xNN00, 0xNN00 }
+	//			../..
+	//		})
+	//
+	//		Method (ACST, 0, NotSerialized)
+	//		{
+	//			Return (Package (0x06)
+	//			{
+	//				One,
+	//				0x04,
+	//				Package (0x04) { ResourceTemplate () { ... }, One, 0x03, 0x03E8 },
+	//				Package (0x04) { ResourceTemplate () { ... }, 0x03, 0xCD, 0x01F4 },
+	//				Package (0x04) { ResourceTemplate () { ... }, 0x06, 0xF5, 0x015E },
+	//				Package (0x04) { ResourceTemplate () { ... }, 0x07, 0xF5, 0xC8 }
+	//			})
+	//		}
+	//	}
+
+	getProcessorName(name, 0);
+	sprintf(path, "\\_PR_.%s", name);
+
+	amlScope(aml, path);
+		amlName(aml, "APSN");
+		amlInteger(aml, gPlatform.CPU.NumCores);
+
+		amlName(aml, "APSS");
+		amlPackage(aml, numberOfPStates);
+
+		for (i = 0; i < numberOfPStates; i++)
+		{
+			amlPackage(aml, 6);
+			amlInteger(aml, pStates[i].Frequency);
+			amlInteger(aml, pStates[i].Power);
+			amlInteger(aml, 10);					// Latency.
+			amlInteger(aml, 10);					// Bus master latency.
+			amlInteger(aml, pStates[i].Ratio);		// Control.
+			amlInteger(aml, pStates[i].Ratio);		// Status.
+			amlClose(aml);
+		}
+
+		amlClose(aml);
+
+		amlMethod(aml, "ACST", 0);
+			amlReturn(aml);
+			amlPackage(aml, (NUMBER_OF_C_STATES + 2));
+				amlInteger(aml, 1);
+				amlInteger(aml, NUMBER_OF_C_STATES);
+				addCStatePackages(aml);
+			amlClose(aml);
+		amlClose(aml);
+
+#if AUTOMATIC_PSS_CST_METHODS_CREATION
+		// Method (_PSS, 0, NotSerialized) { Return (APSS) }
+		amlMethod(aml, "_PSS", 0);
+			amlReturn(aml);
+			amlNameString(aml, "APSS");
+		amlClose(aml);
+
+		// Method (_CST, 0, NotSerialized) { Return (Package (0x05) { 0x04, ... }) }
+		amlMethod(aml, "_CST", 0);
+			amlReturn(aml);
+			amlPackage(aml, (NUMBER_OF_C_STATES + 1));
+				amlInteger(aml, NUMBER_OF_C_STATES);
+				addCStatePackages(aml);
+			amlClose(aml);
+		amlClose(aml);
+#endif	// AUTOMATIC_PSS_CST_METHODS_CREATION
+	amlClose(aml);
+
+	//--------------------------------------------------------------------------
+	// This step adds the following AML code - one for each logical core:
+	//
+	//	Scope (\_PR.CPUn)
+	//	{
+	//		Method (APSS, 0, NotSerialized)
+	//		{
+	//			Return (\_PR.CPU0.APSS)
+	//		}
+	//	}
+
+	for (cpu = 1; cpu < numberOfThreads; cpu++)
 	{
-		/* 0000 */	0x10, 0x22, 0x5C, 0x2E, 0x5F, 0x50, 0x52, 0x5F, 
-		/* 0008 */	_CPU_LABEL_REPLACEMENT, 0x14, 0x16, 0x41, 0x50, 
-		/* 0010 */	0x53, 0x53, 0x00, 0xA4, 0x5C, 0x2F, 0x03, 0x5F, 
-		/* 0018 */	0x50, 0x52, 0x5F, _CPU_LABEL_REPLACEMENT, 0x41, 
-		/* 0020 */	0x50, 0x53, 0x53
-	};
+		getProcessorName(name, cpu);
+		sprintf(path, "\\_PR_.%s", name);
+
+		amlScope(aml, path);
+			amlMethod(aml, "APSS", 0);
+				amlReturn(aml);
+				amlNameString(aml, "\\_PR_." _CPU_LABEL_REPLACEMENT "0.APSS");
+			amlClose(aml);
+
+#if AUTOMATIC_PSS_CST_METHODS_CREATION
+			amlMethod(aml, "_PSS", 0);
+				amlReturn(aml);
+				amlNameString(aml, "\\_PR_." _CPU_LABEL_REPLACEMENT "0.APSS");
+			amlClose(aml);
+
+			amlMethod(aml, "_CST", 0);
+				amlReturn(aml);
+				amlNameString(aml, "\\_PR_." _CPU_LABEL_REPLACEMENT "0._CST");
+			amlClose(aml);
+#endif	// AUTOMATIC_PSS_CST_METHODS_CREATION
+		amlClose(aml);
+	}
+#endif	// AUTOMATIC_P_STATES_CREATION
+}
+
 
-	#define INDEX_OF_CPU_NUMBER			0x0b		// Points to 0x30 in SCOPE_CPU_N (in second _CPU_LABEL_REPLACEMENT).
+//==============================================================================
 
-	typedef struct acpi_2_pss
+void generateSSDT_PR(void)
+{
+	AML_BUILDER aml;
+
+	uint32_t numberOfThreads = gPlatform.CPU.NumThreads;
+
+	if (numberOfThreads > MAX_NUMBER_OF_THREADS)
 	{
-		char		ignored_1[4];					// type, length and package items.
-		uint16_t	Frequency;
-		char		ignored_2;						// var type
-		uint32_t	Power;
-		char		ignored_3[5];					// var type, latency, var type, latency, var type.
-		uint16_t	Ratio;
-		char		ignored_4;						// var type
-		uint16_t	Status;
-	} __attribute__((packed)) ACPI_PSS;
+		numberOfThreads = MAX_NUMBER_OF_THREADS;
+	}
 
+#if AUTOMATIC_P_STATES_CREATION
 	//--------------------------------------------------------------------------
 	// Initialization.
 
-	uint8_t		i = 0;
+	int			i, ratio;
 	uint8_t		numberOfTurboStates	= 0;
 	uint32_t	tdp = (gPlatform.CPU.TDP * 1000);	// See: i386/libsaio/cpu.c
-#endif	// AUTOMATIC_P_STATES_CREATION
 
-	struct acpi_2_ssdt * header = (struct acpi_2_ssdt *) SSDT_PM_HEADER;
-
-#if AUTOMATIC_P_STATES_CREATION
 	// When this is false then initTurboRatios (in cpu.c) didn't find any.
 	if (gPlatform.CPU.NumberOfTurboRatios > 0)
 	{
 #if NUMBER_OF_TURBO_STATES > 4						// See: config/settings.h
 
-		uint8_t numberOfCores = (gPlatform.CPU.NumCores - 1);
+		uint8_t numberOfCores = (gPlatform.CPU.NumCores < STATIC_CPU_NumCores) ? (gPlatform.CPU.NumCores - 1) : (STATIC_CPU_NumCores - 1);
 		// Get turbo range from multipliers.
 		uint8_t	turboRange = (gPlatform.CPU.CoreTurboRatio[0] - gPlatform.CPU.CoreTurboRatio[numberOfCores]);
 
@@ -274,222 +492,30 @@ void generateSSDT_PR(void)
 		// i7-2677M  @1.8 - 2.9 GHz / TDP 17 W / 11
 	}
 
-	uint8_t numberOfPStates = (gPlatform.CPU.MaxBusRatio - gPlatform.CPU.MinBusRatio) + numberOfTurboStates + 1;
+	// One P-State for each 100 MHz bank (AICPUPM wants them all).
+	int numberOfPStates = numberOfTurboStates;
 
-	// Limit number of P-States.
-	if (numberOfPStates > MAX_NUMBER_OF_P_STATES)
+	if (gPlatform.CPU.MaxBusRatio >= gPlatform.CPU.MinBusRatio)
 	{
-		numberOfPStates = MAX_NUMBER_OF_P_STATES;
+		numberOfPStates += ((gPlatform.CPU.MaxBusRatio - gPlatform.CPU.MinBusRatio) + 1);
 	}
 
-	//--------------------------------------------------------------------------
-	// Calculate the buffer size for the AML code.
-	
-	uint32_t bufferSize =	header->Length + 
-							sizeof(SCOPE_PR_CPU0) + 
-							sizeof(NAME_APSN) + 
-							sizeof(NAME_APSS) + 
-							(sizeof(PACKAGE_P_STATE) * numberOfPStates) + 
-							sizeof(METHOD_ACST) + 
-							(sizeof(SCOPE_CPU_N) * (gPlatform.CPU.NumThreads - 1));
-#else
-	uint32_t bufferSize = header->Length;	
-#endif	// #if AUTOMATIC_P_STATES_CREATION
-
-#if AUTOMATIC_DEVICE_SBUS_CREATION					// See: config/settings.h
-
-	bufferSize += sizeof(SCOPE_PCI0_SBUS);			// Increase buffer when required.
-
-#endif	// AUTOMATIC_DEVICE_SBUS_CREATION
-
-#if AUTOMATIC_PROCESSOR_BLOCK_CREATION				// See; config/settings.h
-
-	// Increase buffer for the processor blocks, or we will run out of space.
-	bufferSize += sizeof(SCOPE_PR) + (sizeof(PROCESSOR_DEF_BLOCK) * gPlatform.CPU.NumThreads);
-
-#endif	// AUTOMATIC_PROCESSOR_BLOCK_CREATION
-
-	uint16_t size = 0;
-	void * buffer = malloc(bufferSize);
-	void * bufferPointer = buffer;
-
-	bzero(buffer, bufferSize);						// Clear buffer.
-
-	//--------------------------------------------------------------------------
-	// Copy SSDT header into the newly created buffer.
-	
-	bcopy(SSDT_PM_HEADER, buffer, sizeof(SSDT_PM_HEADER));
-	bufferPointer += sizeof(SSDT_PM_HEADER);
-
-#if AUTOMATIC_DEVICE_SBUS_CREATION					// See: config/settings.h
-	//--------------------------------------------------------------------------
-	// Here we add the following AML code:
-	//
-	//    Scope (\_SB.PCI0)
-	//    {
-	//        Device (SBUS)
-	//        {
-	//            Name (_ADR, 0x001F0003)
-	//            Device (BUS0)
-	//            {
-	//                Name (_CID, "smbus")
-	//                Name (_ADR, Zero)
-	//                Device (DVL0)
-	//                {
-	//                    Name (_ADR, 0x57)
-	//                    Name (_CID, "diagsvault")
-	//                }
-	//            }
-	//        }
-	//    }
-
-	//--------------------------------------------------------------------------
-	// Getting / setting the (static) Scope size.
-
-	size = sizeof(SCOPE_PCI0_SBUS);
-
-	// DHP: Jeroen please check this - we shouldn't need the next two lines.
-
-#if AUTOMATIC_P_STATES_CREATION
-	SCOPE_PCI0_SBUS[ INDEX_OF_SCOPE_LENGTH ]		= (0x40 | (size & 0x0f)) - 1;
-	SCOPE_PCI0_SBUS[ INDEX_OF_SCOPE_LENGTH + 1 ]	= ((size >> 4) & 0xff);
-#endif	// AUTOMATIC_P_STATES_CREATION
-
-	bcopy(SCOPE_PCI0_SBUS, bufferPointer, sizeof(SCOPE_PCI0_SBUS));
-	bufferPointer += sizeof(SCOPE_PCI0_SBUS);
-
-#endif
-
-#if AUTOMATIC_PROCESSOR_BLOCK_CREATION				// See: config/settings.h
-	//--------------------------------------------------------------------------
-	// Here we add the following AML code:
-	//
-	//	Scope (\_PR)
-	//	{
-	//        Processor (CPUn, 0x0n, 0x00000410, 0x06) {}
-	//	      ...
-	
-	/*
-	 * What we do here is to inject the Processor declaration blocks so that  
-	 * you don't have to add them to your DSDT anymore. This way you can boot  
-	 * a new Sandy Bridge setup, with AICPUPM loaded, without even having a 
-	 * (modified) DSDT for it.
-	 *
-	 * Does this sound familiar to you: "<i>I have this and that board and I 
-	 * wanted to know if your DSDT will work for my board</i>"?
-	 *
-	 * Right. Well. This concept might not be new. In fact it isn't, MC did this 
-	 * for his P5K PRO in 2009 already, but it will be a lot more portable.
-	 *
-	 * Let's stop messing with zillions of different (Sandy Bridge) DSDT's and 
-	 * just use a Secondary System Device Table instead, because this is exactly 
-	 * why that was being developed... so let's use it to our advantage ;)
-	 */
-
-	//--------------------------------------------------------------------------
-	// Taking care of the Scope size.
-	
-	size =	sizeof(SCOPE_PR) + (sizeof(PROCESSOR_DEF_BLOCK) * gPlatform.CPU.NumThreads) - 1;
-	
-	SCOPE_PR[ INDEX_OF_SCOPE_LENGTH ]		= (0x40 | (size & 0x0f)) - 1;
-	SCOPE_PR[ INDEX_OF_SCOPE_LENGTH + 1 ]	= ((size >> 4) & 0xff);
-
-	bcopy(SCOPE_PR, bufferPointer, sizeof(SCOPE_PR));
-	bufferPointer += sizeof(SCOPE_PR);
-
-	uint8_t	ctn = 0;
-
-	for (ctn = 0; ctn < gPlatform.CPU.NumThreads; ctn++)
+	if (numberOfPStates > 255)						// Package (NN) limit.
 	{
-		PROCESSOR_DEF_BLOCK[INDEX_OF_PROCESSOR_CPU_ID] = (0x30 + ctn); // Setting CPU name number.
-		PROCESSOR_DEF_BLOCK[INDEX_OF_PROCESSOR_NUMBER] = (ctn + 1); // Setting CPU number.
-		bcopy(PROCESSOR_DEF_BLOCK, bufferPointer, sizeof(PROCESSOR_DEF_BLOCK));
-		bufferPointer += sizeof(PROCESSOR_DEF_BLOCK);
+		numberOfPStates = 255;
 	}
 
-#endif	// AUTOMATIC_PROCESSOR_BLOCK_CREATION
-
-#if AUTOMATIC_P_STATES_CREATION
-	//--------------------------------------------------------------------------
-	// Taking care of the Scope size.
-	
-	size =	sizeof(SCOPE_PR_CPU0) + 
-			sizeof(NAME_APSN) + 
-			sizeof(NAME_APSS) + 
-			(sizeof(PACKAGE_P_STATE) * numberOfPStates) +
-			sizeof(METHOD_ACST);
-	
-	SCOPE_PR_CPU0[ INDEX_OF_SCOPE_LENGTH ]		= (0x40 | (size & 0x0f)) - 1;
-	SCOPE_PR_CPU0[ INDEX_OF_SCOPE_LENGTH + 1 ]	= ((size >> 4) & 0xff);
-
-	//--------------------------------------------------------------------------
-	// Here we add the following AML code:
-	//
-	//	Scope (\_PR.CPU0)
-	//	{
-	//
-
-	bcopy(SCOPE_PR_CPU0, bufferPointer, sizeof(SCOPE_PR_CPU0));
-	bufferPointer += sizeof(SCOPE_PR_CPU0);
-	
-	//--------------------------------------------------------------------------
-	// This step adds the following AML code:
-	//
-	//		Name (APSN, NN)
-
-	// Setting NN in: Name (APSN, NN)
-	NAME_APSN[ INDEX_OF_APSN ] = gPlatform.CPU.NumCores;
-
-	bcopy(NAME_APSN, bufferPointer, sizeof(NAME_APSN));
-	bufferPointer += sizeof(NAME_APSN);
-
-	//--------------------------------------------------------------------------
-	// Taking care of the Package size.
-
-	size = (sizeof(PACKAGE_P_STATE) * numberOfPStates) + 4; // See note below!
-
-	// Note: The explanation for the additional 4 bytes above is as follow:
-	//
-	// Scope/Package with content length + 1 <= 0x3f		= 1
-	// Scope/Package with content length + 2 <= 0x3fff		= 2
-	// Scope/Package with content length + 3 <= 0x3fffff	= 3
-	// Scope/Package with content length + 3  > 0x3fffff	= 4;
-
-	NAME_APSS[ INDEX_OF_PACKAGE_LENGTH ]		= (0x40 | (size & 0x0f)) - 1;
-	NAME_APSS[ INDEX_OF_PACKAGE_LENGTH + 1 ]	= ((size >> 4) & 0xff);
-
-	//--------------------------------------------------------------------------
-	// This step adds the following AML code:
-	//
-	//		Name (APSS, Package (NN)
-	//		{
-
-	// Setting NN in: Name (APSS, Package (NN)
-	NAME_APSS[ INDEX_OF_P_STATES ] = numberOfPStates;
-
-	bcopy(NAME_APSS, bufferPointer, sizeof(NAME_APSS));
-	bufferPointer += sizeof(NAME_APSS);
-
-	//--------------------------------------------------------------------------
-	// This step injects the AML code with the P-States:
-	//
-	//		Package (0x06) { 0xNNNN, 0xNNNN, 10, 10, 0xNN00, 0xNN00 }
-	//		../..
-
-	uint8_t	aPSSPackageCount = 0;
-
-	uint16_t ratio, frequency, status;
-
-	float m, power;
-
-	struct acpi_2_pss * aPSS = (struct acpi_2_pss *) PACKAGE_P_STATE;
+	P_STATE * pStates = (P_STATE *)malloc(numberOfPStates * sizeof(P_STATE));
 
+	uint8_t	pStateCount = 0;
 	uint8_t	maxRatio = gPlatform.CPU.MaxBusRatio;	// Max non-turbo frequency (see CPU specs).
 
+	float m;
+
 	//--------------------------------------------------------------------------
-	// First inject the Turbo P-States.
+	// First the Turbo P-States.
 
-	for (i = 0; i < numberOfTurboStates; i++)
+	for (i = 0; (i < numberOfTurboStates) && (pStateCount < numberOfPStates); i++)
 	{
 		if (numberOfTurboStates	<= 4)
 		{
@@ -497,196 +523,81 @@ void generateSSDT_PR(void)
 		}
 		else
 		{
-			// Having more than the usual four P-States means that we have to 
-			// inject additional P-States (like a MacBookPro8,3) but in this 
+			// Having more than the usual four P-States means that we have to
+			// inject additional P-States (like a MacBookPro8,3) but in this
 			// case we can't just use <i>i</i> but (have to) do it like this:
 			ratio = (gPlatform.CPU.CoreTurboRatio[0] - i);
 		}
-		
+
 		// Check multiplier to prevent out-of-bound frequency - following BITS here. See also: biosbits.org
 		if (ratio == 59 && numberOfTurboStates == 1)
 		{
-			frequency = (maxRatio * 100) + 1;		// Example: 3400 + 1 makes 3401 MHz (instead of 5900)
+			pStates[pStateCount].Frequency = (maxRatio * 100) + 1;	// Example: 3400 + 1 makes 3401 MHz (instead of 5900)
 		}
 		else
 		{
-			frequency = (ratio * 100);
+			pStates[pStateCount].Frequency = (ratio * 100);
 		}
 
-		aPSS->Power		= (uint32_t) tdp;			// Turbo States use TDP.
-
-		//---------------- D O U B L E  V I S I O N  A L E R T! ----------------
-
-		ratio			= status = (ratio << 8);
+		pStates[pStateCount].Power	= tdp;			// Turbo States use TDP.
+		pStates[pStateCount].Ratio	= (ratio << 8);
 
-		aPSS->Frequency	= frequency;
-		aPSS->Ratio		= ratio;
-		aPSS->Status	= ratio;
-
-		aPSSPackageCount++;
-
-		bcopy(PACKAGE_P_STATE, bufferPointer, sizeof(PACKAGE_P_STATE));
-		bufferPointer += sizeof(PACKAGE_P_STATE);
-
-		//----------------------------------------------------------------------
+		pStateCount++;
 	}
 
-	i = gPlatform.CPU.MaxBusRatio;
-
 	//--------------------------------------------------------------------------
 	// And now the 'normal' P-States.
 
-	for (; i >= gPlatform.CPU.MinBusRatio; i--)
+	for (ratio = gPlatform.CPU.MaxBusRatio; (ratio >= gPlatform.CPU.MinBusRatio) && (pStateCount < numberOfPStates); ratio--)
 	{
-		// Do we need to limit the number of P-States?
-		if ((i != gPlatform.CPU.MinBusRatio) && (aPSSPackageCount >= (MAX_NUMBER_OF_P_STATES - 1)))
-		{
-			continue;
-		}
-
-		ratio		= i;
-		frequency	= (i * 100);
-
-		m			= ((1.1 - ((maxRatio - ratio) * 0.00625)) / 1.1);
-		power		= (((float)ratio / maxRatio) * (m * m) * tdp);
+		m = ((1.1 - ((maxRatio - ratio) * 0.00625)) / 1.1);
 
-		aPSS->Power		= (uint32_t) power; // We are using a 32-bit value, even when a  
-											// 16-bit value would be fine, but doing 
-											// that would complicate things even more.
+		pStates[pStateCount].Frequency	= (ratio * 100);
+		pStates[pStateCount].Power		= (uint32_t)(((float)ratio / maxRatio) * (m * m) * tdp);
+		pStates[pStateCount].Ratio		= (ratio << 8);
 
-		//---------------- D O U B L E  V I S I O N  A L E R T! ----------------
-
-		ratio			= status = (ratio << 8);
-
-		aPSS->Frequency	= frequency;
-		aPSS->Ratio		= ratio;
-		aPSS->Status	= ratio;
-
-		aPSSPackageCount++;
-
-		bcopy(PACKAGE_P_STATE, bufferPointer, sizeof(PACKAGE_P_STATE));
-		bufferPointer += sizeof(PACKAGE_P_STATE);
-
-		//----------------------------------------------------------------------
+		pStateCount++;
 	}
+#endif	// AUTOMATIC_P_STATES_CREATION
 
 	//--------------------------------------------------------------------------
-	// This step injects the following AML code:
-	//
-	//	Method (ACST, 0, NotSerialized)
-	//	{
-	//		Return (Package (0x06)
-	//		{
-	//			One,
-	//			0x04,
-	//			Package (0x04)
-	//			{
-	//				ResourceTemplate ()
-	//				{
-	//						Register (FFixedHW,
-	//							0x01,
-	//							0x02,
-	//							0x0000000000000000,
-	//							0x01,
-	//							)
-	//				},
-	//
-	//				One,
-	//				0x03,
-	//				0x03E8
-	//			},
-	//
-	//			Package (0x04)
-	//			{	
-	//				ResourceTemplate ()
-	//				{
-	//						Register (FFixedHW,
-	//							0x01,
-	//							0x02,
-	//							0x0000000000000010,
-	//							0x03,
-	//							)
-	//				},
-	//
-	//				0x03,
-	//				0xCD, 
-	//				0x01F4
-	//			},
-	//
-	//			Package (0x04)
-	//			{	
-	//				ResourceTemplate ()
-	//				{
-	//						Register (FFixedHW,
-	//							0x01,
-	//							0x02,
-	//							0x0000000000000020,
-	//							0x03,
-	//							)
-	//				},
-	//
-	//				0x06,
-	//				0xF5, 
-	//				0x015E
-	//			},
-	//
-	//			Package (0x04)
-	//			{	
-	//				ResourceTemplate ()
-	//				{
-	//						Register (FFixedHW,
-	//							0x01,
-	//							0x02,
-	//							0x0000000000000030,
-	//							0x03,
-	//							)
-	//				},
-	//
-	//				0x07,
-	//				0xF5, 
-	//				0xC8
-	//			},
-	//		})
-	//	}
+	// Measure the AML code first, so that we can write it straight into kernel
+	// memory (see amlOpen in aml_generator.h for details).
 
-	bcopy(METHOD_ACST, bufferPointer, sizeof(METHOD_ACST));
-	bufferPointer += sizeof(METHOD_ACST);
+	bzero(&aml, sizeof(aml));
 
-	//--------------------------------------------------------------------------
-	// This step adds the following AML code - one for each logical core:
-	//
-	//	Scope (\_PR.CPUn)
-	//	{
-	//		Method (APSS, 0, NotSerialized)
-	//		{
-	//			Return (\_PR.CPU0.APSS)
-	//		}
-	//	}
+#if AUTOMATIC_P_STATES_CREATION
+	addSSDT_PR(&aml, numberOfThreads, pStates, pStateCount);
+	amlAllocate(&aml);
+	addSSDT_PR(&aml, numberOfThreads, pStates, pStateCount);
 
-	for (i = 1; i < gPlatform.CPU.NumThreads; i++)
-	{
-		SCOPE_CPU_N[INDEX_OF_CPU_NUMBER] = (0x30 + i);		// Setting CPU number.
-		bcopy(SCOPE_CPU_N, bufferPointer, sizeof(SCOPE_CPU_N));
-		bufferPointer += sizeof(SCOPE_CPU_N);
-	}
+	free(pStates);
+#else
+	addSSDT_PR(&aml, numberOfThreads);
+	amlAllocate(&aml);
+	addSSDT_PR(&aml, numberOfThreads);
+#endif
 
-#endif	// AUTOMATIC_P_STATES_CREATION
+	amlRelease(&aml);
 
 	//--------------------------------------------------------------------------
 	// Here we generate a new checksum.
 	// Note:	The length and checksum should be the same as a normal ssdt_pr.aml
 	//			but might vary due to (lack of) optimization.
 
-	header = (struct acpi_2_ssdt *) buffer;
-	
-	header->Length		= bufferSize;
+	struct acpi_2_ssdt * header = (struct acpi_2_ssdt *) aml.buffer;
+
+	header->Length		= aml.offset;
 	header->Checksum	= 0;
-	header->Checksum	= checksum8(buffer, header->Length);
+	header->Checksum	= checksum8(aml.buffer, header->Length);
+
+	_ACPI_DEBUG_DUMP("SSDT_PR generated for %d threads (%d bytes).\n", numberOfThreads, aml.offset);
 
 	//--------------------------------------------------------------------------
-	// Updating customTables with the required data.
+	// Updating customTables with the required data (already in kernel memory).
 
-	customTables[SSDT_PR].table			= (void *)(uint32_t)buffer;
-	customTables[SSDT_PR].tableLength	= bufferSize;
-	customTables[SSDT_PR].loaded		= true;		// Simulate a file load - to let it call free()
+	customTables[SSDT_PR].table			= (void *)aml.buffer;
+	customTables[SSDT_PR].tableAddress	= (void *)aml.buffer;
+	customTables[SSDT_PR].tableLength	= aml.offset;
+	customTables[SSDT_PR].loaded		= false;
 }
@@ -36,6 +36,17 @@
 #define kPageSize		4096
 #define RoundPage(x)	((((unsigned)(x)) + kPageSize - 1) & ~(kPageSize - 1))
 
+#if DYNAMIC_MEMORY_LAYOUT
+	#define kLayoutAlign	0x00100000ULL	// 1 MB.
+	#define kLayoutLimit	0xFFF00000ULL	// Everything below 4 GB (we run in 32-bit protected mode).
+	#define kKernelLimit	0x40000000ULL	// Kernel vmaddrs are masked with 0x3fffffff (see DecodeSegment in load.c).
+
+	#define kZallocMaxLen	0x20000000ULL	// 512 MB.
+	#define kLoadMaxLen		0x10000000ULL	// 256 MB.
+
+MemoryLayout gMemoryLayout = { KERNEL_FIXED_LEN, ZALLOC_FIXED_ADDR, ZALLOC_FIXED_LEN, LOAD_FIXED_ADDR, LOAD_FIXED_LEN };
+#endif
+
 
 //==============================================================================
 
@@ -43,26 +54,22 @@ long AllocateMemoryRange(char * rangeName, long start, long length)
 {
 	if (rangeName)
 	{
-		char *nameBuf = malloc(strlen(rangeName) + 1);
-	
-		if (nameBuf)
+		// One allocation for the range (first) and its name.
+		uint32_t *buffer = malloc((2 * sizeof(uint32_t)) + strlen(rangeName) + 1);
+
+		if (buffer)
 		{
-			strcpy(nameBuf, rangeName);
-			uint32_t *buffer = malloc(2 * sizeof(uint32_t));
+			char *nameBuf = (char *)&buffer[2];
 
-			if (buffer)
-			{
-				buffer[0] = start;
-				buffer[1] = length;
+			strcpy(nameBuf, rangeName);
+			buffer[0] = start;
+			buffer[1] = length;
 #if DEBUG
-				printf("AllocateMemoryRange(%s) @0x%lx, length 0x%lx\n", rangeName, start, length);
+			printf("AllocateMemoryRange(%s) @0x%lx, length 0x%lx\n", rangeName, start, length);
 #endif
-				DT__AddProperty(gPlatform.EFI.Nodes.MemoryMap, nameBuf, 2 * sizeof(uint32_t), (char *)buffer);
-			
-				return 0;
-			}
+			DT__AddProperty(gPlatform.EFI.Nodes.MemoryMap, nameBuf, 2 * sizeof(uint32_t), (char *)buffer);
 
-			free(nameBuf);
+			return 0;
 		}
 	}
 
@@ -96,3 +103,92 @@ long AllocateKernelMemory(long inSize)
 
 	return address;
 }
+
+
+#if DYNAMIC_MEMORY_LAYOUT
+//==============================================================================
+// Called from initKernelBootConfig() in bootstruct.c right after getMemoryMap().
+//
+// The kernel area must start at KERNEL_ADDR (where the kernel is linked to run)
+// so it gets the usable range at 1 MB, up to the zalloc and file load areas that
+// go either to the largest other usable range (below 4 GB) or to the top of the
+// first one. The fixed layout is kept when the memory map is missing or too small.
+
+void planMemoryLayout(MemoryRange * rangeArray, unsigned long rangeCount)
+{
+	unsigned long i;
+	unsigned long long base, end, size, lowEnd = 0, highBase = 0, highEnd = 0;
+
+	for (i = 0; i < rangeCount; i++)
+	{
+		MemoryRange * range = &rangeArray[i];
+
+		if (range->type != kMemoryRangeUsable)
+		{
+			continue;
+		}
+
+		base = (range->base + kLayoutAlign - 1) & ~(kLayoutAlign - 1);
+		end = (range->base + range->length) & ~(kLayoutAlign - 1);
+
+		if (end > kLayoutLimit)
+		{
+			end = kLayoutLimit;
+		}
+
+		if ((range->base <= KERNEL_ADDR) && (end > KERNEL_ADDR))
+		{
+			lowEnd = end;
+		}
+		else if ((base >= KERNEL_ADDR) && (end > base) && ((end - base) > (highEnd - highBase)))
+		{
+			highBase = base;
+			highEnd = end;
+		}
+	}
+
+	size = (lowEnd > KERNEL_ADDR) ? (lowEnd - KERNEL_ADDR) : 0;
+
+	if (size >= (KERNEL_FIXED_LEN + ZALLOC_FIXED_LEN + LOAD_FIXED_LEN))
+	{
+		// Give zalloc a quarter, and the file load buffer an eighth, of the memory.
+		unsigned long long zallocLength = (size + (highEnd - highBase)) / 4;
+		unsigned long long loadLength = (size + (highEnd - highBase)) / 8;
+
+		zallocLength = (zallocLength < ZALLOC_FIXED_LEN) ? ZALLOC_FIXED_LEN : (zallocLength > kZallocMaxLen) ? kZallocMaxLen : zallocLength;
+		loadLength = (loadLength < LOAD_FIXED_LEN) ? LOAD_FIXED_LEN : (loadLength > kLoadMaxLen) ? kLoadMaxLen : loadLength;
+
+		zallocLength = (zallocLength + kLayoutAlign - 1) & ~(kLayoutAlign - 1);
+		loadLength = (loadLength + kLayoutAlign - 1) & ~(kLayoutAlign - 1);
+
+		if ((highEnd - highBase) >= (zallocLength + loadLength))
+		{
+			gMemoryLayout.ZallocAddress = highBase;
+		}
+		else
+		{
+			// Both go to the top of the first range (leaving at least KERNEL_FIXED_LEN).
+			if ((size - zallocLength - loadLength) < KERNEL_FIXED_LEN)
+			{
+				zallocLength = ZALLOC_FIXED_LEN;
+				loadLength = LOAD_FIXED_LEN;
+			}
+
+			lowEnd -= (zallocLength + loadLength);
+			gMemoryLayout.ZallocAddress = lowEnd;
+		}
+
+		gMemoryLayout.ZallocLength	= zallocLength;
+		gMemoryLayout.LoadAddress	= (gMemoryLayout.ZallocAddress + zallocLength);
+		gMemoryLayout.LoadLength	= loadLength;
+		gMemoryLayout.KernelLength	= (((lowEnd > kKernelLimit) ? kKernelLimit : lowEnd) - KERNEL_ADDR);
+	}
+
+	mallocRelocate((char *)ZALLOC_ADDR, ZALLOC_LEN);
+
+	_PLATFORM_DEBUG_DUMP("Memory layout (%ld E820 ranges):\n", rangeCount);
+	_PLATFORM_DEBUG_DUMP("Kernel: 0x%08lx - 0x%08lx\n", (unsigned long)KERNEL_ADDR, (KERNEL_ADDR + KERNEL_LEN));
+	_PLATFORM_DEBUG_DUMP("Zalloc: 0x%08lx - 0x%08lx\n", ZALLOC_ADDR, (ZALLOC_ADDR + ZALLOC_LEN));
+	_PLATFORM_DEBUG_DUMP("Load  : 0x%08lx - 0x%08lx\n", LOAD_ADDR, (LOAD_ADDR + LOAD_LEN));
+}
+#endif
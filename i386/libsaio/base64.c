@@ -15,6 +15,7 @@
  *				- Workaround for "___bzero" undefined error in RevoBoot (PikerAlpha, November 2012)
  *				- base64Charset moved to function decodeQuantum (PikerAlpha, November 2012)
  *				- base64 length check and character checking added (PikerAlpha, November 2012)
+ *				- Table driven single pass decoder (returns the length without padding), base64Encode added.
  *
  */
 
@@ -33,243 +34,165 @@
 	#include "libsaio.h"
 #endif
 
-#define FULL_BASE64_DATA_CHECK	0
-
-#if DEBUG_BASE64_DECODE
-	int quickLookups = 0;
-#endif
-
 #define PADDINGCHAR				'=' // 61 - 0x3d
 
 #define TABLELEN				64
 
+#define BASE64_SKIP				0xff	// Layout characters (think line feeds and tabs) and junk.
+#define BASE64_PAD				0xfe
+
+static const char base64Charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Character to 6-bit value lookup table (initialized on first use).
+static unsigned char base64DecodeTable[256];
+
 
 //==============================================================================
 // Helper function for base64Decode
 
-bool validBase64Length(char * aDataPtr)
+static void initBase64DecodeTable(void)
 {
-	size_t length = (strlen(aDataPtr) - 1);
-	
-	if (length && (length % 4))
+	int i;
+
+	memset(base64DecodeTable, BASE64_SKIP, sizeof(base64DecodeTable));
+
+	for (i = 0; i < TABLELEN; i++)
 	{
-		return true;
+		base64DecodeTable[(unsigned char)base64Charset[i]] = i;
 	}
-	
-	return false;
+
+	base64DecodeTable[PADDINGCHAR] = BASE64_PAD;
 }
 
 
 //==============================================================================
-// Helper function for base64Decode
+// Decodes the base64 encoded input in a single pass. Layout characters and
+// invalid characters are skipped, and decoding stops at the first padding
+// character. Returns the number of decoded bytes (padding not included) and
+// the data (via decodedData) which should be released with free().
 
-char *cleanupBase64Data(char *aDataPtr)
+int base64Decode(char *input, unsigned char **decodedData)
 {
-	int index		= 0;
-#if DEBUG_BASE64_DECODE
-	int i = 0;
-	int junkChars	= 0;
-#endif
+	const unsigned char * table = base64DecodeTable;
+	const unsigned char * ptr = (const unsigned char *)input;
 
-	size_t length = strlen(aDataPtr);
+	unsigned char *buffer = NULL;
+	unsigned char *output = NULL;
 
-	char *cleanedUpData = malloc(length);
-	bzero(cleanedUpData, length);
+	unsigned int v0, v1, v2, v3, x = 0, count = 0;
 
-	// Main loop
-	while (*aDataPtr)
+	if (table[0] != BASE64_SKIP)
 	{
-		/*
-		 * This check acts as a first pass filter. Its purpose is to strip invalid
-		 * characters from the base64 encoded data, but we are mainly using it to
-		 * get rid of the layout enhancement characters (think line feeds and tabs).
-		 */
-		if (*aDataPtr > 42 && *aDataPtr < 123)
-		{
-#if FULL_BASE64_DATA_CHECK
-			/*
-			 * Additional checking is normally not required, but may help people
-			 * getting passed messed up plist data fields (think hand editing).
-			 */
-			if (*aDataPtr > 43 && *aDataPtr < 47)		// ,-.
-			{
-				aDataPtr++;
-#if DEBUG_BASE64_DECODE
-				junkChars++;
-#endif
-			}
-			else if (*aDataPtr > 57 && *aDataPtr < 65)	// :'<=>?@
-			{
-				if (*aDataPtr == PADDINGCHAR)
-				{
-					cleanedUpData[index++] = *aDataPtr;
-#if DEBUG_BASE64_DECODE
-					printf("%c", cleanedUpData[length]);
-#endif
-				}
-				else
-				{
-					aDataPtr++;
-#if DEBUG_BASE64_DECODE
-					junkChars++;
-#endif
-				}
-			}
-			else if (*aDataPtr > 90 && *aDataPtr < 97)	// [\]^_`
-			{
-				aDataPtr++;
-#if DEBUG_BASE64_DECODE
-				junkChars++;
-#endif
-			}
-			else
-			{
-#endif
-				cleanedUpData[index++] = *aDataPtr;
-#if DEBUG_BASE64_DECODE
-				printf("%c", cleanedUpData[index]);
-#endif
-#if FULL_BASE64_DATA_CHECK
-			}
-#endif
-		}
-#if DEBUG_BASE64_DECODE
-		else
-		{
-			junkChars++;
-		}
-#endif
-		aDataPtr++;
+		initBase64DecodeTable();
 	}
 
-	cleanedUpData[index] = 0;
+	// Three bytes for every four characters, and one quantum for the tail.
+	buffer = output = (unsigned char *)malloc(((strlen(input) / 4) * 3) + 3);
 
-#if DEBUG_BASE64_DECODE
-	printf("\njunkChars : %d\n", junkChars);
-	
-	length = strlen(cleanedUpData);
-
-	for (i = 0; i < length; i++)
+	if (buffer == NULL)
 	{
-		printf("%c", cleanedUpData[i]);
+		return 0;
 	}
-#endif
 
-	return cleanedUpData;
-}
+	while (*ptr)
+	{
+		/*
+		 * Fast path: four valid characters in a row decode straight into three
+		 * bytes. Note that the lookups stop at the first skip/pad character so
+		 * we never read past the terminating zero (which is BASE64_SKIP).
+		 */
+		if (count == 0 &&
+			(v0 = table[ptr[0]]) < TABLELEN && (v1 = table[ptr[1]]) < TABLELEN &&
+			(v2 = table[ptr[2]]) < TABLELEN && (v3 = table[ptr[3]]) < TABLELEN)
+		{
+			x = ((v0 << 18) | (v1 << 12) | (v2 << 6) | v3);
 
+			output[0] = (x >> 16);
+			output[1] = (x >> 8);
+			output[2] = x;
 
-//==============================================================================
-// Helper function for base64Decode
+			output += 3;
+			ptr += 4;
 
-void decodeQuantum(char *input, unsigned char *output)
-{
-	int i = 0;
-	int j = 0;
-#if DEBUG_BASE64_DECODE
-	int found = 0;
-#endif
+			continue;
+		}
 
-	unsigned int x = 0; // We use a 32 bit wide variable for our bit shifting.
-	const char * base64Charset = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		// Slow path: one character at a time.
+		v0 = table[*ptr++];
 
-	for (i = 0; i < 4; i++)
-	{
-		if (input[i] == PADDINGCHAR)
-		{
-			x = (x << 6);
-#if DEBUG_BASE64_DECODE
-			found++;
-#endif
-		}
-		else if (input[(i - 1)] == input[i]) // Same character as last one?
+		if (v0 == BASE64_PAD)
 		{
-#if DEBUG_BASE64_DECODE
-			found++;
-			quickLookups++;
-#endif
-			x = (x << 6) + j;
+			break;
 		}
-		else // Dig for next valid target character.
+		else if (v0 != BASE64_SKIP)
 		{
-			for (j = 0; j < TABLELEN; j++)
+			x = ((x << 6) | v0);
+
+			if (++count == 4)
 			{
-				if (base64Charset[j] == input[i])
-				{
-					x = (x << 6) + j;
-#if DEBUG_BASE64_DECODE
-					found++;
-#endif
-					break;
-				}
+				output[0] = (x >> 16);
+				output[1] = (x >> 8);
+				output[2] = x;
+
+				output += 3;
+				count = x = 0;
 			}
 		}
 	}
+
+	// Partial quantum (the padded one). A single character is not valid.
+	if (count == 2)
+	{
+		*output++ = (x >> 4);
+	}
+	else if (count == 3)
+	{
+		*output++ = (x >> 10);
+		*output++ = (x >> 2);
+	}
 #if DEBUG_BASE64_DECODE
-	if (found < 4)
+	else if (count == 1)
 	{
-		printf("ERROR ");
+		printf("\nError: Invalid length of base64 data!\n");
 	}
 #endif
-	
-	output[2] = x;
-	output[1] = (x >>= 8);
-	output[0] = (x >>= 8);
+
+	*decodedData = buffer;
+
+	return (output - buffer);
 }
 
 
 //==============================================================================
+// Returns a new (zero terminated) base64 encoded copy of the data, which
+// should be released with free(). Used for binary plists (see bplist.c).
 
-int base64Decode(char *input, unsigned char **decodedData)
+char * base64Encode(const unsigned char *data, size_t length)
 {
-	size_t bytes = 0;
+	char * string = malloc(((length + 2) / 3) * 4 + 1);
 
-	unsigned char *buffer = NULL;
-	
-	input = cleanupBase64Data(input);
-	
-	if (validBase64Length(input))
+	if (string)
 	{
-		int numQuantums = (strlen(input) / 4);
-	
-		if (numQuantums)
-		{
-#if DEBUG_BASE64_DECODE
-			printf("\nnumQuantums : %d\n\n", numQuantums);
-#endif
-			buffer = (unsigned char *)malloc(numQuantums * 3);
-
-			if (buffer)
-			{
-				int i = 0;
-
-				*decodedData = buffer;
+		char * ptr = string;
+		size_t i;
+		unsigned int x;
 
-				while (bytes < (numQuantums / 3))
-				{
-					for (i = 0; i < numQuantums; i++)
-					{
-						decodeQuantum(input, buffer);
-#if DEBUG_BASE64_DECODE
-						printf("%2ld : %02x %02x %02x\n", (bytes / 3), *buffer++, *buffer++, *buffer++);
-#else
-						buffer += 3;
-#endif
-						input += 4;
-						bytes += 3;
-					}
-				}
-			}
+		for (i = 0; i < length; i += 3)
+		{
+			x = (data[i] << 16);
+			x |= ((i + 1) < length) ? (data[i + 1] << 8) : 0;
+			x |= ((i + 2) < length) ? data[i + 2] : 0;
+
+			*ptr++ = base64Charset[(x >> 18) & 0x3f];
+			*ptr++ = base64Charset[(x >> 12) & 0x3f];
+			*ptr++ = ((i + 1) < length) ? base64Charset[(x >> 6) & 0x3f] : PADDINGCHAR;
+			*ptr++ = ((i + 2) < length) ? base64Charset[x & 0x3f] : PADDINGCHAR;
 		}
+
+		*ptr = '\0';
 	}
-#if DEBUG_BASE64_DECODE
-	else
-	{
-		printf("\nError: Invalid length of base64 data!\n");
-	}
-#endif
 
-	return bytes;
+	return string;
 }
 
 
@@ -286,12 +209,12 @@ void convertEFIGUIDToString(EFI_GUID const *aGuid, char **aUUIDString)
 		//          1         2         3
 		// 123456789 123456789 123456789 123456
 		// 00000000-0000-0000-0000-000000000000
-		*aUUIDString = (char *)malloc(36);
+		*aUUIDString = (char *)malloc(37);
 	}
 	
 	if (*aUUIDString)
 	{
-		bzero(*aUUIDString, 36);
+		bzero(*aUUIDString, 37);
 		sprintf(*aUUIDString, "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
 				aGuid->Data1, /* - */
 				aGuid->Data2, /* - */
@@ -354,7 +277,8 @@ char * getStartupDiskUUID(char * aDataPtr)
 
 	int rc = base64Decode(aDataPtr, &decodedData);
 
-	if ((rc == 75) && (decodedData != NULL))
+	// 74 bytes of device path data (base64Decode no longer counts the padding).
+	if ((rc == 74) && (decodedData != NULL))
 	{
 #if USE_DEVICE_PATH
 		EFI_DEVICE_PATH_PROTOCOL * dp = (EFI_DEVICE_PATH_PROTOCOL *) decodedData;
@@ -372,6 +296,101 @@ char * getStartupDiskUUID(char * aDataPtr)
 	return startupDiskUUID;
 }
 
+//==============================================================================
+// Reference decoder (one character at a time, no tables) for the test in main.
+
+int referenceDecode(char *input, unsigned char *output)
+{
+	int bytes = 0, count = 0;
+	unsigned int x = 0;
+	char * found;
+
+	for (; *input && *input != PADDINGCHAR; input++)
+	{
+		if ((found = strchr(base64Charset, *input)) != NULL)
+		{
+			x = ((x << 6) | (found - base64Charset));
+
+			if (++count == 4)
+			{
+				output[bytes++] = (x >> 16);
+				output[bytes++] = (x >> 8);
+				output[bytes++] = x;
+				count = x = 0;
+			}
+		}
+	}
+
+	if (count > 1)
+	{
+		x <<= (6 * (4 - count));
+		output[bytes++] = (x >> 16);
+
+		if (count == 3)
+		{
+			output[bytes++] = (x >> 8);
+		}
+	}
+
+	return bytes;
+}
+
+
+//==============================================================================
+// Encodes random data, adds layout characters, and compares base64Decode with
+// the reference decoder.
+
+int compareWithReference(int rounds)
+{
+	int i, j, length, errors = 0;
+
+	unsigned char data[256], expected[256];
+	unsigned char * decodedData = NULL;
+
+	for (i = 0; i < rounds; i++)
+	{
+		length = (rand() % sizeof(data));
+
+		for (j = 0; j < length; j++)
+		{
+			data[j] = rand();
+		}
+
+		char * encoded = base64Encode(data, length);
+		char * input = malloc((strlen(encoded) * 2) + 1);
+		char * ptr = input;
+
+		for (j = 0; encoded[j]; j++)
+		{
+			if ((rand() % 8) == 0)
+			{
+				*ptr++ = "\n\r\t "[rand() % 4];
+			}
+
+			*ptr++ = encoded[j];
+		}
+
+		*ptr = '\0';
+
+		int size = base64Decode(input, &decodedData);
+
+		if (size != length || referenceDecode(input, expected) != length || memcmp(decodedData, data, length) || memcmp(expected, data, length))
+		{
+			printf("Error: mismatch for length %d (decoded %d)\n", length, size);
+			errors++;
+		}
+
+		free(decodedData);
+		free(input);
+		free(encoded);
+	}
+
+	printf("%d rounds, %d errors\n", rounds, errors);
+
+	return errors;
+}
+
+
 //==============================================================================
 
 int main(void)
@@ -398,6 +417,11 @@ int main(void)
 	// c8 2a 14 01 02 03	= Mac Address (example)
 	// c0 a8 c0 01			= IP address 192.168.192.1 (example)
 
+	if (compareWithReference(10000))
+	{
+		exit(1);
+	}
+
 	char * uuid = getStartupDiskUUID(input);
 
 	if (uuid)
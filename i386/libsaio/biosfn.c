@@ -357,6 +357,7 @@ int biosread(int dev, int cyl, int head, int sec, int num)
 
 		bb.eax.r.h = 0x02;
 		bios(&bb);
+		IO_STAT(biosCalls, 1);
 
 		// In case of a successful call, make sure we set AH (return code) to zero.
 		if (bb.flags.cf == 0)
@@ -371,6 +372,7 @@ int biosread(int dev, int cyl, int head, int sec, int num)
 		}
 
         // Reset disk subsystem and try again.
+		IO_STAT(retries, 1);
 		bb.eax.r.h = 0x00;
 		bios(&bb);
 	}
@@ -410,6 +412,7 @@ int ebiosread(int dev, unsigned long long sec, int count)
 		addrpacket.bufferSegment = SEGMENT(ptov(BIOS_ADDR));
 		addrpacket.startblock    = sec;
 		bios(&bb);
+		IO_STAT(biosCalls, 1);
 
 		// In case of a successful call, make sure we set AH (return code) to zero.
 		if (bb.flags.cf == 0)
@@ -424,6 +427,7 @@ int ebiosread(int dev, unsigned long long sec, int count)
 		}
 
         // Reset disk subsystem and try again.
+		IO_STAT(retries, 1);
 		bb.eax.r.h = 0x00;
 		bios(&bb);
 	}
@@ -38,17 +38,24 @@ PrivateBootInfo_t *bootInfo;
 
 void initKernelBootConfig(void)
 {
-	bootArgs = (kernel_boot_args *)malloc(sizeof(boot_args));
-	bootInfo = (PrivateBootInfo_t *)malloc(sizeof(PrivateBootInfo_t));
+#if DYNAMIC_MEMORY_LAYOUT
+	MemoryRange memoryMap[kMemoryMapCountMax];
+	unsigned long convmem, extmem;
+
+	// Read the memory map first, because bootInfo doesn't fit in the bootstrap heap.
+	unsigned long memoryMapCount = getMemoryMap(memoryMap, kMemoryMapCountMax, &convmem, &extmem);
+
+	planMemoryLayout(memoryMap, memoryMapCount);
+#endif
+
+	bootArgs = (kernel_boot_args *)calloc(1, sizeof(boot_args));
+	bootInfo = (PrivateBootInfo_t *)calloc(1, sizeof(PrivateBootInfo_t));
 
 	if (bootArgs == 0 || bootInfo == 0)
 	{
 		stop("Couldn't allocate boot info\n");
 	}
 
-	bzero(bootArgs, sizeof(boot_args));
-	bzero(bootInfo, sizeof(PrivateBootInfo_t));
-
 	// Set kernel name to: '/System/Library/Kernels/kernel' for 10.10 and greater
 	// and 'mach_kernel' for all previous versions of OS X.
 	// strcpy(bootInfo->bootFile, kDefaultKernel);
@@ -57,9 +64,17 @@ void initKernelBootConfig(void)
 	// Get system memory map. Also update the size of the
 	// conventional/extended memory for backwards compatibility.
 
+#if DYNAMIC_MEMORY_LAYOUT
+	bootInfo->memoryMapCount	= memoryMapCount;
+	bootInfo->convmem			= convmem;
+	bootInfo->extmem			= extmem;
+
+	bcopy(memoryMap, bootInfo->memoryMap, (memoryMapCount * sizeof(MemoryRange)));
+#else
 	bootInfo->memoryMapCount = getMemoryMap(bootInfo->memoryMap, kMemoryMapCountMax,
 											(unsigned long *) &bootInfo->convmem, 
 											(unsigned long *) &bootInfo->extmem);
+#endif
 
 	if (bootInfo->memoryMapCount == 0)
 	{
@@ -200,7 +215,16 @@ void finalizeKernelBootConfig(void)
     // add PCI info somehow into device tree
     // XXX
 
-    // Flatten device tree
+#if (BOOT_PROFILER || IO_STATISTICS)
+    // Adds device tree properties (do this before flattening it).
+    exportBootProfile();
+#endif
+
+#if BOOT_IO_TRACE
+    exportBootIOTrace();
+#endif
+
+    // Flatten device tree (getting the size is cheap, only the second call walks the tree).
     DT__FlattenDeviceTree(0, &size);
     addr = (void *)AllocateKernelMemory(size);
 
@@ -215,9 +239,11 @@ void finalizeKernelBootConfig(void)
     bootArgs->deviceTreeLength = size;
 	
 #if ((MAKE_TARGET_OS & LION) == LION) // All OS versions greater than Lion have bit 1 set.
+#if (BOOT_PROFILER == 0)
 	// Adding a 16 KB log space.
 	bootArgs->performanceDataSize	= 0;
 	bootArgs->performanceDataStart	= 0;
+#endif
 
 	// AppleKeyStore.kext
 	bootArgs->keyStoreDataSize	= 0;
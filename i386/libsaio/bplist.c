@@ -0,0 +1,385 @@
+/*
+ *
+ * bplist.c
+ *
+ * Binary property list (bplist00) reader. Builds the same tag tree as the XML
+ * parser in xml.c so that callers can use XMLGetProperty() for both formats.
+ *
+ */
+
+#include "libsaio.h"
+#include "xml.h"
+
+#if BINARY_PLIST_SUPPORT
+
+#define DEBUG_BPLIST			0
+
+#define kBPlistMagic			"bplist00"
+#define kBPlistMagicLength		8
+#define kBPlistTrailerLength	32
+#define kBPlistMaxDepth			32	// Nesting limit (also catches reference loops).
+
+/*
+ * Object markers (high nibble) and the simple values (low nibble) of marker 0.
+ */
+#define kBPlistSimple			0x0
+#define kBPlistInteger			0x1
+#define kBPlistReal				0x2
+#define kBPlistDate				0x3
+#define kBPlistData				0x4
+#define kBPlistASCIIString		0x5
+#define kBPlistUnicodeString	0x6
+#define kBPlistArray			0xA
+#define kBPlistDict				0xD
+
+#define kBPlistFalse			0x08
+#define kBPlistTrue				0x09
+
+
+typedef struct BPlist
+{
+	const uint8_t *	buffer;
+	uint32_t		length;
+	uint32_t		offsetTable;
+	uint8_t			offsetSize;		// Size of the entries in the offset table.
+	uint8_t			refSize;		// Size of the object references.
+	uint32_t		objectCount;
+	uint32_t		tagBudget;		// Number of tags that we may still create.
+} BPlist;
+
+
+static TagPtr ParseObject(BPlist * plist, uint32_t ref, int depth);
+
+
+//==============================================================================
+// Returns the big-endian integer at 'ptr' (only the lower 32 bits are used).
+
+static uint32_t ReadInteger(const uint8_t * ptr, uint8_t size)
+{
+	uint32_t value = 0;
+
+	while (size--)
+	{
+		value = ((value << 8) | *ptr++);
+	}
+
+	return value;
+}
+
+
+//==============================================================================
+// Returns the offset of an object, or 0 for invalid references.
+
+static uint32_t GetObjectOffset(BPlist * plist, uint32_t ref)
+{
+	if (ref < plist->objectCount)
+	{
+		uint32_t offset = ReadInteger(plist->buffer + plist->offsetTable + (ref * plist->offsetSize), plist->offsetSize);
+
+		if (offset >= kBPlistMagicLength && offset < plist->offsetTable)
+		{
+			return offset;
+		}
+	}
+
+	return 0;
+}
+
+
+//==============================================================================
+// Returns the object count in the low nibble of the marker, or the integer
+// object that follows the marker for counts of 15 and up. Advances 'offset'
+// to the first byte of the object data. Returns -1 on error.
+
+static long GetObjectCount(BPlist * plist, uint32_t * offset)
+{
+	uint8_t marker = plist->buffer[*offset];
+	uint32_t count = (marker & 0x0f);
+
+	*offset += 1;
+
+	if (count == 0x0f)
+	{
+		uint8_t intMarker = plist->buffer[*offset];
+		uint8_t size = (1 << (intMarker & 0x0f));
+
+		if ((intMarker >> 4) != kBPlistInteger || size > 8 || (*offset + 1 + size) > plist->offsetTable)
+		{
+			return -1;
+		}
+
+		count = ReadInteger(plist->buffer + *offset + 1, size);
+		*offset += (1 + size);
+	}
+
+	return (count < plist->length) ? (long)count : -1;
+}
+
+
+//==============================================================================
+// Returns a (zero terminated) copy of an ASCII or UTF-16BE string as UTF-8.
+
+static char * CopyString(const uint8_t * data, uint32_t count, bool isUnicode)
+{
+	char * string = malloc(isUnicode ? ((count * 3) + 1) : (count + 1));
+
+	if (string)
+	{
+		if (isUnicode)
+		{
+			char * ptr = string;
+
+			// Surrogate pairs are copied as two separate characters.
+			for (; count--; data += 2)
+			{
+				uint16_t c = ((data[0] << 8) | data[1]);
+
+				if (c < 0x80)
+				{
+					*ptr++ = c;
+				}
+				else if (c < 0x800)
+				{
+					*ptr++ = (0xc0 | (c >> 6));
+					*ptr++ = (0x80 | (c & 0x3f));
+				}
+				else
+				{
+					*ptr++ = (0xe0 | (c >> 12));
+					*ptr++ = (0x80 | ((c >> 6) & 0x3f));
+					*ptr++ = (0x80 | (c & 0x3f));
+				}
+			}
+
+			*ptr = '\0';
+		}
+		else
+		{
+			memcpy(string, data, count);
+			string[count] = '\0';
+		}
+	}
+
+	return string;
+}
+
+
+//==============================================================================
+// Arrays and dictionaries. Note that the XML parser prepends the elements of a
+// list, and that we do the same so that both trees are identical.
+
+static TagPtr ParseList(BPlist * plist, uint32_t offset, long type, int depth)
+{
+	uint32_t i, ref;
+	TagPtr tag, subTag, keyTag;
+
+	long count = GetObjectCount(plist, &offset);
+
+	// Dictionaries store all key references, followed by all value references.
+	uint32_t refCount = (type == kTagTypeDict) ? (count * 2) : count;
+
+	if (count < 0 || (offset + (refCount * plist->refSize)) > plist->offsetTable)
+	{
+		return NULL;
+	}
+
+	tag = XMLNewTag(type, NULL);
+
+	if (tag == NULL)
+	{
+		return NULL;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		ref = ReadInteger(plist->buffer + offset + (i * plist->refSize), plist->refSize);
+
+		if (type == kTagTypeArray)
+		{
+			// Unsupported objects (reals, sets etc.) are left out.
+			if ((subTag = ParseObject(plist, ref, depth)) == NULL)
+			{
+				continue;
+			}
+		}
+		else
+		{
+			keyTag = ParseObject(plist, ref, depth);
+
+			if (keyTag == NULL || keyTag->type != kTagTypeString)
+			{
+				XMLFreeTag(keyTag);
+				XMLFreeTag(tag);
+
+				return NULL;
+			}
+
+			// Turn the string into a key, with the value as its child (like <key>).
+			subTag = keyTag;
+			subTag->type = kTagTypeKey;
+
+			ref = ReadInteger(plist->buffer + offset + ((count + i) * plist->refSize), plist->refSize);
+
+			subTag->tag = ParseObject(plist, ref, depth);
+		}
+
+		subTag->tagNext = tag->tag;
+		tag->tag = subTag;
+	}
+
+	return tag;
+}
+
+
+//==============================================================================
+// Returns a new tag for object 'ref' or NULL for unsupported and invalid data.
+
+static TagPtr ParseObject(BPlist * plist, uint32_t ref, int depth)
+{
+	TagPtr tag = NULL;
+
+	char * string = NULL;
+
+	uint32_t offset = GetObjectOffset(plist, ref);
+
+	/*
+	 * Objects can be referenced more than once, which is fine for strings but
+	 * containers that reference each other could make us build a huge tree.
+	 * The tree of a valid plist has no more tags than it has references.
+	 */
+	if (offset == 0 || ++depth > kBPlistMaxDepth || plist->tagBudget == 0)
+	{
+		return NULL;
+	}
+
+	plist->tagBudget--;
+
+	uint8_t marker = plist->buffer[offset];
+
+	switch (marker >> 4)
+	{
+		case kBPlistSimple:
+
+			if (marker == kBPlistFalse || marker == kBPlistTrue)
+			{
+				tag = XMLNewTag((marker == kBPlistTrue) ? kTagTypeTrue : kTagTypeFalse, NULL);
+			}
+
+			break;
+
+		case kBPlistInteger:
+			// The XML parser does not store integer values either.
+			tag = XMLNewTag(kTagTypeInteger, NULL);
+			break;
+
+		case kBPlistDate:
+			tag = XMLNewTag(kTagTypeDate, NULL);
+			break;
+
+		case kBPlistData:
+		case kBPlistASCIIString:
+		case kBPlistUnicodeString:
+		{
+			bool isUnicode = ((marker >> 4) == kBPlistUnicodeString);
+			long count = GetObjectCount(plist, &offset);
+
+			if (count < 0 || (offset + (isUnicode ? (count * 2) : count)) > plist->offsetTable)
+			{
+				break;
+			}
+
+			// XML keeps <data> base64 encoded (decoded when used) so we do the same.
+			if ((marker >> 4) == kBPlistData)
+			{
+				string = base64Encode(plist->buffer + offset, count);
+			}
+			else
+			{
+				string = CopyString(plist->buffer + offset, count, isUnicode);
+			}
+
+			if (string)
+			{
+				tag = XMLNewTag(((marker >> 4) == kBPlistData) ? kTagTypeData : kTagTypeString, string);
+
+				free(string);
+			}
+
+			break;
+		}
+
+		case kBPlistArray:
+			tag = ParseList(plist, offset, kTagTypeArray, depth);
+			break;
+
+		case kBPlistDict:
+			tag = ParseList(plist, offset, kTagTypeDict, depth);
+			break;
+	}
+
+#if DEBUG_BPLIST
+	if (tag == NULL)
+	{
+		printf("BPlist: skipped object %d (marker 0x%02x)\n", ref, marker);
+	}
+#endif
+
+	return tag;
+}
+
+
+//==============================================================================
+
+bool XMLIsBinaryPlist(const char * buffer, long length)
+{
+	return (buffer && length > (kBPlistMagicLength + kBPlistTrailerLength) && !memcmp(buffer, kBPlistMagic, kBPlistMagicLength));
+}
+
+
+//==============================================================================
+// Expects a dictionary as top level object. Puts it in the tag pointer and
+// returns the length of the plist, or -1 on error (does not modify 'buffer').
+
+long XMLParseBinaryPlist(const char * buffer, long length, TagPtr * dict)
+{
+	if (XMLIsBinaryPlist(buffer, length))
+	{
+		BPlist plist;
+
+		const uint8_t * trailer = (const uint8_t *)buffer + length - kBPlistTrailerLength;
+
+		// The 64-bit big-endian values of the trailer are limited to 32 bits.
+		plist.buffer		= (const uint8_t *)buffer;
+		plist.length		= length;
+		plist.offsetSize	= trailer[6];
+		plist.refSize		= trailer[7];
+		plist.objectCount	= ReadInteger(trailer + 12, 4);
+		plist.offsetTable	= ReadInteger(trailer + 28, 4);
+		plist.tagBudget		= (plist.refSize ? (length / plist.refSize) : 0) + 1;
+
+		uint32_t topObject	= ReadInteger(trailer + 20, 4);
+
+		if (plist.offsetSize && plist.offsetSize <= 4 && plist.refSize && plist.refSize <= 4 &&
+			plist.offsetTable < (length - kBPlistTrailerLength) &&
+			plist.objectCount <= ((length - kBPlistTrailerLength - plist.offsetTable) / plist.offsetSize))
+		{
+			TagPtr tag = ParseObject(&plist, topObject, 0);
+
+			if (tag && tag->type == kTagTypeDict)
+			{
+				*dict = tag;
+
+				return length;
+			}
+
+			XMLFreeTag(tag);
+		}
+#if DEBUG_BPLIST
+		printf("BPlist: invalid or unsupported binary plist\n");
+#endif
+	}
+
+	return -1;
+}
+
+#endif /* BINARY_PLIST_SUPPORT */
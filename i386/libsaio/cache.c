@@ -139,6 +139,7 @@ long CacheRead(CICell ih, char * buffer, long long offset, long length, long cac
 #if CACHE_STATS
             gCacheHits++;
 #endif
+            IO_STAT(blockCacheHits, 1);
             return gCacheBlockSize;
         }
 
@@ -157,6 +158,11 @@ long CacheRead(CICell ih, char * buffer, long long offset, long length, long cac
 	}
 #endif
 
+    if (cache)
+	{
+		IO_STAT(blockCacheMisses, 1);
+	}
+
     // Put the data from the disk in the cache if needed.
     if (loadCache)
 	{
@@ -187,6 +193,7 @@ long CacheRead(CICell ih, char * buffer, long long offset, long length, long cac
 #if CACHE_STATS
             gCacheEvicts++;
 #endif
+            IO_STAT(blockCacheEvicts, 1);
         }
 
         // Copy the data from disk to the new entry.
@@ -59,59 +59,28 @@ void initTurboRatios()
 
 #if AUTOMATIC_SSDT_PR_CREATION || DEBUG_CPU_TURBO_RATIOS
 	// All CPU's have at least two cores (think mobility CPU here).
-	gPlatform.CPU.CoreTurboRatio[0] = bitfield32(msr, 7, 0);
-	gPlatform.CPU.CoreTurboRatio[1] = bitfield32(msr, 15, 8);
-	
-	// Additionally for quad and six core CPU's.
-	if (gPlatform.CPU.NumCores >= 4)	// Up to 8 threads.
-	{
-		gPlatform.CPU.CoreTurboRatio[2] = bitfield32(msr, 23, 16);
-		gPlatform.CPU.CoreTurboRatio[3] = bitfield32(msr, 31, 24);
-
-#if STATIC_CPU_NumCores >= 6			// 12 threads.
-		// For the lucky few with a six core Gulftown CPU.
-		//
-		// bitfield32() supports 32 bit values only and thus we 
-		// have to do it a little different here (bit shifting).
-		gPlatform.CPU.CoreTurboRatio[4] = ((msr >> 32) & 0xff);
-		gPlatform.CPU.CoreTurboRatio[5] = ((msr >> 40) & 0xff);
-#endif
-
-#if STATIC_CPU_NumCores == 8			// 16 threads.
-		// Westmere-EX support (E7-2820/E7-2830).
-		gPlatform.CPU.CoreTurboRatio[6] = ((msr >> 48) & 0xff);
-		gPlatform.CPU.CoreTurboRatio[7] = ((msr >> 56) & 0xff);
-#endif
+	uint8_t core, numberOfRatios = (gPlatform.CPU.NumCores > 2) ? gPlatform.CPU.NumCores : 2;
 
-#if STATIC_CPU_NumCores >= 10			// 20 threads.
-		msr = rdmsr64(MSR_TURBO_RATIO_LIMIT_1);
-
-		gPlatform.CPU.CoreTurboRatio[8] = bitfield32(msr, 7, 0);
-		gPlatform.CPU.CoreTurboRatio[9] = bitfield32(msr, 15, 8);
-#endif
-
-#if STATIC_CPU_NumCores >= 12			// 24 threads.
-		gPlatform.CPU.CoreTurboRatio[10] = bitfield32(msr, 23, 16);
-		gPlatform.CPU.CoreTurboRatio[11] = bitfield32(msr, 31, 24);
-#endif
+	if (numberOfRatios > STATIC_CPU_NumCores)
+	{
+		numberOfRatios = STATIC_CPU_NumCores;
+	}
 
-#if STATIC_CPU_NumCores >= 16			// 32 threads.
-		gPlatform.CPU.CoreTurboRatio[12] = ((msr >> 32) & 0xff);
-		gPlatform.CPU.CoreTurboRatio[13] = ((msr >> 40) & 0xff);
-		gPlatform.CPU.CoreTurboRatio[14] = ((msr >> 48) & 0xff);
-		gPlatform.CPU.CoreTurboRatio[15] = ((msr >> 56) & 0xff);
-#endif
-		
-#if STATIC_CPU_NumCores >= 18			// 36 threads.
-		// Intel® Xeon® Processor E5 v3 Family (0x3F – based on the Haswell-E microarchitecture)
-		// Intel® Xeon® Processor E7 v2 Family (0x3E – based on the Ivy Bridge-E microarchitecture)
-		// can check bit-64 to see if the two extra Turbo MSR's are being used or not.
-		msr = rdmsr64(MSR_TURBO_RATIO_LIMIT_2);
-		
-		gPlatform.CPU.CoreTurboRatio[16] = bitfield32(msr, 7, 0);
-		gPlatform.CPU.CoreTurboRatio[17] = bitfield32(msr, 15, 8);
+	// Each MSR holds the turbo ratios for eight active core counts; 1-8 in
+	// MSR_TURBO_RATIO_LIMIT, 9-16 in MSR_TURBO_RATIO_LIMIT_1 and 17-24 in
+	// MSR_TURBO_RATIO_LIMIT_2 (many-core Xeons only).
+	for (core = 0; (core < numberOfRatios) && (core < 24); core++)
+	{
+		if (core == 8)
+		{
+			msr = rdmsr64(MSR_TURBO_RATIO_LIMIT_1);
+		}
+		else if (core == 16)
+		{
+			msr = rdmsr64(MSR_TURBO_RATIO_LIMIT_2);
+		}
 
-#endif
+		gPlatform.CPU.CoreTurboRatio[core] = ((msr >> ((core & 7) * 8)) & 0xff);
 	}
 
 	// Jeroen:	This code snippet was copied from ACPI/ssdt_pr_generator.h 
@@ -67,11 +67,12 @@
 
 static inline uint64_t rdtsc64(void)
 {
-	uint64_t ret;
-	
-	__asm__ volatile("rdtsc" : "=A" (ret));
+	uint32_t lo, hi;
 
-	return ret;
+	// Not "=A" which is only EDX:EAX on i386 (the host build is x86_64).
+	__asm__ volatile("rdtsc" : "=a" (lo), "=d" (hi));
+
+	return ((uint64_t)hi << 32) | lo;
 }
 
 
@@ -72,6 +72,27 @@ static struct _DTSizeInfo
 static Node * freeNodes, *allocedNodes;
 static Property *freeProperties, *allocedProperties;
 
+// Names of the nodes created by DT__FindNode (released by DT__Finalize).
+static arena_t * nodeNames;
+
+#define kNodeNamesChunkSize 256
+
+
+//==============================================================================
+// FNV-1a hash of a node name.
+
+static uint32_t HashName(const char *name)
+{
+	uint32_t hash = 2166136261UL;
+
+	while (*name)
+	{
+		hash = ((hash ^ (uint8_t)*name++) * 16777619UL);
+	}
+
+	return hash;
+}
+
 
 //==============================================================================
 
@@ -81,7 +102,7 @@ Property * DT__AddProperty(Node *node, const char *name, uint32_t length, void *
 
 	if (freeProperties == NULL)
 	{
-		void *buf = malloc(kAllocSize);
+		void *buf = calloc(1, kAllocSize);
 		int i;
 
 	#if (DEBUG_EFI & 2)
@@ -93,7 +114,6 @@ Property * DT__AddProperty(Node *node, const char *name, uint32_t length, void *
 			return 0;
 		}
 
-		bzero(buf, kAllocSize);
 		// Use the first property to record the allocated buffer for later freeing.
 		prop = (Property *)buf;
 		prop->next = allocedProperties;
@@ -152,7 +172,7 @@ Node * DT__AddChild(Node *parent, const char *name)
 
 	if (freeNodes == NULL)
 	{
-		void *buf = malloc(kAllocSize);
+		void *buf = calloc(1, kAllocSize);
 
 		if (buf == 0)
 		{
@@ -165,7 +185,6 @@ Node * DT__AddChild(Node *parent, const char *name)
 		_EFI_DEBUG_DUMP("Allocating more free nodes\n");
 #endif
 
-		bzero(buf, kAllocSize);
 		node = (Node *)buf;
 
 		// Use the first node to record the allocated buffer for later freeing.
@@ -206,7 +225,11 @@ Node * DT__AddChild(Node *parent, const char *name)
 	}
 
 	DTInfo.numNodes++;
-	
+
+	// Cache the name so that DT__GetName/DT__FindNode don't have to look it up.
+	node->name = name;
+	node->nameHash = HashName(name);
+
 	DT__AddProperty(node, "name", strlen(name) + 1, (void *) name);
 
 	return node;
@@ -262,31 +285,38 @@ void DT__Initialize(void)
 
 void DT__Finalize(void)
 {
-	Node *node;
-	Property *prop;
+	Node *node, *nextNode;
+	Property *prop, *nextProp;
 
 #if (DEBUG_EFI & 8)
 	_EFI_DEBUG_DUMP("DT__Finalize\n");
 #endif
 
-	for (prop = allocedProperties; prop != NULL; prop = prop->next)
+	// Note: the list headers live in the buffers that we free (get 'next' first).
+	for (prop = allocedProperties; prop != NULL; prop = nextProp)
 	{
+		nextProp = prop->next;
 		free(prop->value);
 	}
 
 	allocedProperties = NULL;
 	freeProperties = NULL;
 
-	for (node = allocedNodes; node != NULL; node = node->next)
+	for (node = allocedNodes; node != NULL; node = nextNode)
 	{
+		nextNode = node->next;
 		free((void *)node->children);
 	}
 
 	allocedNodes = NULL;
 	freeNodes = NULL;
 	gPlatform.DT.RootNode = NULL;
-    
-	// XXX leaks any created strings
+
+	if (nodeNames)
+	{
+		arena_reset(nodeNames);
+	}
+
 	DTInfo.numNodes = 0;
 	DTInfo.numProperties = 0;
 	DTInfo.totalPropertySize = 0;
@@ -302,6 +332,7 @@ static void * FlattenNodes(Node *node, void *buffer)
 	Property *prop;
 	DeviceTreeNode *flatNode;
 	DeviceTreeNodeProperty *flatProp;
+	uint32_t length;
 	int count;
 
 	if (node == 0)
@@ -315,11 +346,24 @@ static void * FlattenNodes(Node *node, void *buffer)
 	for (count = 0, prop = node->properties; prop != 0; count++, prop = prop->next)
 	{
 		flatProp = (DeviceTreeNodeProperty *)buffer;
-		strcpy(flatProp->name, prop->name);
+		// Zero filled (and truncated) name, so that we don't have to clear the buffer.
+		for (length = 0; length < (kPropNameLength - 1) && prop->name[length]; length++)
+		{
+			flatProp->name[length] = prop->name[length];
+		}
+
+		bzero(&flatProp->name[length], kPropNameLength - length);
 		flatProp->length = prop->length;
 		buffer += sizeof(DeviceTreeNodeProperty);
 		bcopy(prop->value, buffer, prop->length);
-		buffer += RoundToLong(prop->length);
+
+		// Clear the alignment padding (if any).
+		for (length = prop->length; length & 3; length++)
+		{
+			((char *)buffer)[length] = 0;
+		}
+
+		buffer += length;
 	}
 
 	flatNode->nProperties = count;
@@ -337,6 +381,8 @@ static void * FlattenNodes(Node *node, void *buffer)
 
 /*==============================================================================
  * Flatten the in-memory representation of the device tree into a binary DT block.
+ * The size is tracked while the tree is built, so the size query is cheap, and
+ * the flattened tree is written in a single pass (without clearing it first).
  * To get the buffer size needed, call with result = 0.
  * To have a buffer allocated for you, call with *result = 0.
  * To use your own buffer, call with *result = &buffer.
@@ -381,8 +427,6 @@ void DT__FlattenDeviceTree(void **buffer_p, uint32_t *length)
 				buf = *buffer_p;
 			}
 
-			bzero(buf, totalSize);
-
 			FlattenNodes(gPlatform.DT.RootNode, buf);
 		}
 
@@ -400,26 +444,11 @@ void DT__FlattenDeviceTree(void **buffer_p, uint32_t *length)
 
 char * DT__GetName(Node *node)
 {
-	Property *prop;
-
 #if (DEBUG_EFI & 8)
 	_EFI_DEBUG_DUMP("DT__GetName(0x%x)\n", node);
-	_EFI_DEBUG_DUMP("Node properties = 0x%x\n", node->properties);
 #endif
 
-	for (prop = node->properties; prop; prop = prop->next)
-	{
-#if (DEBUG_EFI & 8)
-		_EFI_DEBUG_DUMP("Prop '%s'\n", prop->name);
-#endif
-		if (strcmp(prop->name, "name") == 0)
-		{
-			return prop->value;
-		}
-	}
-
-	//_EFI_DEBUG_DUMP("DT__GetName returns 0\n");
-	return "(null)";
+	return node->name ? (char *)node->name : "(null)";
 }
 
 
@@ -431,6 +460,7 @@ Node * DT__FindNode(const char *path, bool createIfMissing)
 	DTPropertyNameBuf nameBuf;
 	char *bp;
 	int i;
+	uint32_t hash;
 
 #if (DEBUG_EFI & 2)
 	_EFI_DEBUG_DUMP("DT__FindNode('%s', %d)\n", path, createIfMissing);
@@ -449,9 +479,10 @@ Node * DT__FindNode(const char *path, bool createIfMissing)
 			path++;
 		}
 
-		for (i = 0, bp = nameBuf; ++i < kDTMaxEntryNameLength && *path && *path != '/'; bp++, path++)
+		for (i = 0, bp = nameBuf, hash = 2166136261UL; ++i < kDTMaxEntryNameLength && *path && *path != '/'; bp++, path++)
 		{
 			*bp = *path;
+			hash = ((hash ^ (uint8_t)*bp) * 16777619UL); // Same as HashName()
 		}
 
 		*bp = '\0';
@@ -469,7 +500,7 @@ Node * DT__FindNode(const char *path, bool createIfMissing)
 #if (DEBUG_EFI & 2)
 			_EFI_DEBUG_DUMP("Child 0x%x\n", child);
 #endif
-			if (strcmp(DT__GetName(child), nameBuf) == 0)
+			if (child->nameHash == hash && strcmp(child->name, nameBuf) == 0)
 			{
 				break;
 			}
@@ -481,8 +512,18 @@ Node * DT__FindNode(const char *path, bool createIfMissing)
 			_EFI_DEBUG_DUMP("Creating node\n");
 #endif
 
-			char *str = malloc(strlen(nameBuf) + 1);
-			// XXX this will leak
+			if (nodeNames == NULL)
+			{
+				nodeNames = arena_create(kNodeNamesChunkSize);
+			}
+
+			char *str = nodeNames ? arena_alloc(nodeNames, strlen(nameBuf) + 1) : NULL;
+
+			if (str == NULL)
+			{
+				return NULL;
+			}
+
 			strcpy(str, nameBuf);
 
 			child = DT__AddChild(node, str);
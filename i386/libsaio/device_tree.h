@@ -48,6 +48,8 @@ typedef struct _Node
 	struct _Property *	last_prop;
 	struct _Node *		children;
 	struct _Node *		next;
+	const char *		name;		// Value of the "name" property.
+	uint32_t			nameHash;	// Used by DT__FindNode.
 } Node;
 
 extern Property * DT__AddProperty(Node *node, const char *name, uint32_t length, void *value);
@@ -59,6 +59,8 @@
 #include "fdisk.h"
 #include "hfs.h"
 
+#include <libkern/OSByteOrder.h>
+
 
 #define DPISTRLEN	32 // Defined in: IOKit/storage/IOApplePartitionScheme.h
 
@@ -307,7 +309,8 @@ static const char * bios_error(int errnum)
 static int Biosread(int biosdev, unsigned long long secno)
 {
 	static int xbiosdev;
-	static unsigned int xsec, xnsecs;
+	static unsigned long long xsec;
+	static unsigned int xnsecs;
 	struct driveInfo di;
 
 	int  rc = -1;
@@ -342,9 +345,10 @@ static int Biosread(int biosdev, unsigned long long secno)
 
 	if ((biosdev >= kBIOSDevTypeHardDrive) && (di.uses_ebios & EBIOS_FIXED_DISK_ACCESS))
 	{
-		if (cache_valid && (biosdev == xbiosdev) && (secno >= xsec) && ((unsigned int)secno < (xsec + xnsecs)))
+		if (cache_valid && (biosdev == xbiosdev) && (secno >= xsec) && (secno < (xsec + xnsecs)))
 		{
 			biosbuf = trackbuf + (BPS * (secno - xsec));
+			IO_STAT(trackCacheHits, 1);
 			return 0;
 		}
 
@@ -352,10 +356,29 @@ static int Biosread(int biosdev, unsigned long long secno)
 		xsec = (secno / divisor) * divisor;
 		cache_valid = false;
 
+#if BOOT_IO_TRACE
+		if (divisor == 1)
+		{
+			recordDiskRead(biosdev, xsec, xnsecs);
+
+			if (readPrefetched(biosdev, xsec, xnsecs, trackbuf))
+			{
+				IO_STAT(prefetchHits, 1);
+
+				cache_valid = true;
+				biosbuf = trackbuf;
+				xbiosdev = biosdev;
+
+				return 0;
+			}
+		}
+#endif
+
 		while ((rc = ebiosread(biosdev, secno / divisor, xnsecs / divisor)) && (++tries < 5))
 		{
 			if (rc == ECC_CORRECTED_ERR)
 			{
+				IO_STAT(eccCorrected, 1);
 				rc = 0; // Ignore corrected ECC errors.
 				break;
 			}
@@ -381,6 +404,7 @@ static int Biosread(int biosdev, unsigned long long secno)
 		{
 			// this sector is in trackbuf cache.
 			biosbuf = trackbuf + (BPS * (sec - xsec));
+			IO_STAT(trackCacheHits, 1);
 			return 0;
 		}
 
@@ -396,6 +420,7 @@ static int Biosread(int biosdev, unsigned long long secno)
 		{
 			if (rc == ECC_CORRECTED_ERR)
 			{
+				IO_STAT(eccCorrected, 1);
 				rc = 0; // Ignore corrected ECC errors.
 				break;
 			}
@@ -410,6 +435,7 @@ static int Biosread(int biosdev, unsigned long long secno)
 	if (rc == 0) // BIOS reported success, mark sector cache as valid.
 	{
 		cache_valid = true;
+		IO_STAT(sectorsRead, xnsecs);
 	}
 
 	biosbuf  = trackbuf + (secno % divisor) * BPS;
@@ -427,6 +453,40 @@ int testBiosread(int biosdev, unsigned long long secno)
 }
 
 
+#if BOOT_IO_TRACE
+//==============================================================================
+// Used by prefetchBootIOTrace() to read up to N_CACHE_SECS sectors with one
+// EBIOS call, bypassing (and invalidating) the track cache. Returns 0 or an
+// INT13/F42 error code.
+
+int readDiskSectors(int biosdev, unsigned long long secno, unsigned int count, void * buffer)
+{
+	int rc;
+
+	if (count > N_CACHE_SECS)
+	{
+		return -1;
+	}
+
+	cache_valid = false;
+
+	if ((rc = ebiosread(biosdev, secno, count)) == ECC_CORRECTED_ERR)
+	{
+		IO_STAT(eccCorrected, 1);
+		rc = 0;
+	}
+
+	if (rc == 0)
+	{
+		IO_STAT(sectorsRead, count);
+		bcopy(trackbuf, buffer, (count * BPS));
+	}
+
+	return rc;
+}
+#endif
+
+
 //==============================================================================
 
 static int readBytes(int biosdev, unsigned long long blkno, unsigned int byteoff, unsigned int byteCount, void * buffer)
@@ -458,6 +518,7 @@ static int readBytes(int biosdev, unsigned long long blkno, unsigned int byteoff
 
 		copy_len = ((byteCount + byteoff) > BPS) ? (BPS - byteoff) : byteCount;
 		bcopy( biosbuf + byteoff, cbuf, copy_len );
+		IO_STAT(bytesCopied, copy_len);
 		byteCount -= copy_len;
 		byteoff = 0;
 	}
@@ -472,12 +533,10 @@ static int readBytes(int biosdev, unsigned long long blkno, unsigned int byteoff
 
 static BVRef initNewBVRef(int biosdev, int partno, unsigned int blkoff)
 {
-	BVRef bvr = (BVRef) malloc(sizeof(*bvr));
+	BVRef bvr = (BVRef) calloc(1, sizeof(*bvr));
 	
 	if (bvr)
 	{
-		bzero(bvr, sizeof(*bvr));
-		
 		bvr->biosdev			= biosdev;
 		bvr->part_no			= partno;
 		bvr->part_boff			= blkoff;
@@ -504,7 +563,7 @@ static BVRef probeBVRef(BVRef bvr, unsigned int bvrFlags)
 {
 	bvr->flags |= kBVFlagNativeBoot;	// 0x02
 		
-	if (readBootSector(bvr->biosdev, bvr->part_boff, (void *)0x7e00) == 0)
+	if (readBootSector(bvr->biosdev, bvr->part_boff, (void *)ptov(BOOT0_ADDR)) == 0)
 	{
 		bvr->flags |= kBVFlagBootable;	// 0x08
 	}
@@ -421,6 +421,7 @@ void finalizeEFITree(EFI_UINT32 kernelAdler32)
 	DT__AddProperty(gPlatform.EFI.Nodes.Chosen, "boot-kernelcache-adler32", sizeof(EFI_UINT32), (EFI_UINT32*)kernelAdler32);
 
 	_EFI_DEBUG_DUMP("Calling setupSMBIOS()\n");
+	BOOT_PHASE(kBootPhaseSetupSMBIOS);
 	setupSMBIOS();
 
 	_EFI_DEBUG_DUMP("Adding EFI configuration table for SMBIOS(");
@@ -475,6 +476,7 @@ void finalizeEFITree(EFI_UINT32 kernelAdler32)
 	_EFI_DEBUG_DUMP("done)\nCalling setupACPI(");
 
 	// DHP: Pfff. Setting DEBUG to 1 in acpi_patcher.c breaks our layout!
+	BOOT_PHASE(kBootPhaseSetupACPI);
 	setupACPI();
 
 	_EFI_DEBUG_DUMP("done).\nAdding EFI configuration table for ACPI(");
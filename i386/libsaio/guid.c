@@ -17,12 +17,12 @@ void convertEFIGUIDToString(EFI_GUID const *aGuid, char **aUUIDString)
 		//          1         2         3
 		// 123456789 123456789 123456789 123456
 		// 00000000-0000-0000-0000-000000000000
-		*aUUIDString = (char *)malloc(36);
+		*aUUIDString = (char *)malloc(37);
 	}
 
 	if (*aUUIDString)
 	{
-		bzero(*aUUIDString, 36);
+		bzero(*aUUIDString, 37);
 		sprintf(*aUUIDString, "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
 				aGuid->Data1, /* - */
 				aGuid->Data2, /* - */
@@ -132,7 +132,8 @@ char * getStartupDiskUUID(char * aDataPtr)
 
 	int rc = base64Decode(aDataPtr, &decodedData);
 
-	if ((rc == 75) && (decodedData != NULL))
+	// 74 bytes of device path data (base64Decode no longer counts the padding).
+	if ((rc == 74) && (decodedData != NULL))
 	{
 #if USE_DEVICE_PATH
 		EFI_DEVICE_PATH_PROTOCOL * dp = (EFI_DEVICE_PATH_PROTOCOL *) decodedData;
@@ -143,9 +144,10 @@ char * getStartupDiskUUID(char * aDataPtr)
 		
 		convertEFIGUIDToString(uuid, &startupDiskUUID);
 #endif
-		free(decodedData);
 	}
 
+	free(decodedData);
+
 	return startupDiskUUID;
 }
 #endif // #if DISK_TARGET_SUPPORT
@@ -70,6 +70,7 @@ static HFSMasterDirectoryBlock	*gHFSMDB =(HFSMasterDirectoryBlock*)gHFSMdbVib;
 static char						gHFSPlusHeader[kBlockSize];
 static HFSPlusVolumeHeader		*gHFSPlus =(HFSPlusVolumeHeader*)gHFSPlusHeader;
 static char						gLinkTemp[64];
+static char						gTempStr[4096];
 
 #endif /* !__i386__ */
 
@@ -783,6 +784,7 @@ static long GetCatalogEntry(long * dirIndex, char ** name, long * flags, long *
 	
 	// Read the BTree node and get the record for index.
 	ReadExtent(extent, extentSize, kHFSCatalogFileID, curNode * nodeSize, nodeSize, nodeBuf, 1);
+	IO_STAT(btreeNodeReads[kBTreeCatalog], 1);
 	GetBTreeRecord(index, nodeBuf, nodeSize, &testKey, &entry);
 	GetCatalogEntryInfo(entry, flags, time, finderInfo, infoValid);
 	
@@ -954,6 +956,7 @@ static long ReadBTreeEntry(long btree, void * key, char * entry, long * dirIndex
 	{
 		// Read the current node.
 		ReadExtent(extent, extentSize, extentFile, curNode * nodeSize, nodeSize, nodeBuf, 1);
+		IO_STAT(btreeNodeReads[btree], 1);
 		
 		// Find the matching key.
 		lowerBound = 0;
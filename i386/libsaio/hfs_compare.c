@@ -43,7 +43,7 @@ static unsigned short * deCompressStructure(struct CompressedBlock *cb, int coun
 {
 	int i, j;
 
-	unsigned short *out = malloc(size);
+	unsigned short *out = malloc(size * sizeof(unsigned short)); // size is the number of elements.
 
 	if (out)
 	{
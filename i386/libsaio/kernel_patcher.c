@@ -0,0 +1,513 @@
+/*
+ *
+ * kernel_patcher.c
+ *
+ * Declarative find/replace patches for the kernel and prelinked kexts. Patches
+ * come from a compiled table (see the LOAD.C section in the settings file) and
+ * can optionally be loaded from: /Extra/KernelPatches.plist
+ *
+ * Symbol anchored patches are resolved with a single lookupSymbols() sweep in
+ * load.c and section wide patches are applied in one pass per section, using
+ * a first byte prefilter that only compares the patches that can match there.
+ *
+ */
+
+#include "platform.h"
+#include "kernel_patcher.h"
+#include "xml.h"
+
+
+#define UINT64_TO_BYTES(v)	{ (uint8_t)(v), (uint8_t)((v) >> 8), (uint8_t)((v) >> 16), (uint8_t)((v) >> 24), \
+							  (uint8_t)((v) >> 32), (uint8_t)((v) >> 40), (uint8_t)((v) >> 48), (uint8_t)((v) >> 56) }
+
+#if (PATCH_KEXT_LOADING && ((MAKE_TARGET_OS & EL_CAPITAN) == EL_CAPITAN))
+static const uint8_t loadExecutableFind[]		= UINT64_TO_BYTES(LOAD_EXECUTABLE_TARGET_UINT64);
+static const uint8_t loadExecutableReplace[]	= UINT64_TO_BYTES(LOAD_EXECUTABLE_PATCH_UINT64);
+
+#if PATCH_XCPI_SCOPE_MSRS
+// Zero out the first three scope MSR entries (0x30 bytes apart).
+static const uint8_t xcpmScopeMsrsFind[0x68]		= UINT64_TO_BYTES(XCPM_SCOPE_MSRS_TARGET_UINT64);
+static const uint8_t xcpmScopeMsrsFindMask[0x68]	= { [0x00 ... 0x07] = 0xff };
+static const uint8_t xcpmScopeMsrsReplace[0x68]		= { 0x00 };
+static const uint8_t xcpmScopeMsrsReplaceMask[0x68]	= { [0x00 ... 0x07] = 0xff, [0x30 ... 0x37] = 0xff, [0x60 ... 0x67] = 0xff };
+#endif
+
+#if PATCH_LOAD_EXTRA_KEXTS
+static const uint8_t readStartupExtensionsFind[]	= UINT64_TO_BYTES(READ_STARTUP_EXTENSIONS_TARGET_UINT64);
+static const uint8_t readStartupExtensionsReplace[]	= UINT64_TO_BYTES(READ_STARTUP_EXTENSIONS_PATCH_UINT64);
+#endif
+#endif
+
+
+//==============================================================================
+// Compiled patch table. Note: The last (empty) entry is only there to prevent
+// an empty array, and it is not included in gKernelPatchCount.
+
+static KernelPatch staticKernelPatches[] =
+{
+#if (PATCH_KEXT_LOADING && ((MAKE_TARGET_OS & EL_CAPITAN) == EL_CAPITAN))
+	{
+		"OSKext::loadExecutable", "__ZN6OSKext14loadExecutableEv", 1 /* __TEXT,__text */, NULL, NULL,
+		0x300, sizeof(loadExecutableFind), loadExecutableFind, NULL, loadExecutableReplace, NULL, 1, false
+	},
+#if PATCH_XCPI_SCOPE_MSRS
+	#define XCPM_SCOPE_MSRS_PATCH	1
+	{
+		"xcpm_core_scope_msrs", "_xcpm_core_scope_msrs", 8 /* __DATA,__data */, NULL, NULL,
+		0x3f, sizeof(xcpmScopeMsrsFind), xcpmScopeMsrsFind, xcpmScopeMsrsFindMask, xcpmScopeMsrsReplace, xcpmScopeMsrsReplaceMask, 1, false
+	},
+#endif
+#if PATCH_LOAD_EXTRA_KEXTS
+	{
+		"KLDBootstrap::readStartupExtensions", "__ZN12KLDBootstrap21readStartupExtensionsEv", 25 /* __KLD,__text */, NULL, NULL,
+		0x3f, sizeof(readStartupExtensionsFind), readStartupExtensionsFind, NULL, readStartupExtensionsReplace, NULL, 1, false
+	},
+#endif
+#endif
+	{ NULL }
+};
+
+static KernelPatch *	gKernelPatches		= staticKernelPatches;
+static int				gKernelPatchCount	= ((sizeof(staticKernelPatches) / sizeof(KernelPatch)) - 1);
+
+// Patch numbers of the symbol anchored patches (in lookup target order).
+static int				gAnchoredPatches[MAX_KERNEL_PATCHES];
+static int				gAnchoredPatchCount	= 0;
+
+
+//==============================================================================
+
+static bool matchPatch(const uint8_t * p, KernelPatch * patch)
+{
+	uint32_t index = 0;
+
+	for (; index < patch->length; index++)
+	{
+		uint8_t mask = patch->findMask ? patch->findMask[index] : 0xff;
+
+		if ((p[index] ^ patch->find[index]) & mask)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+//==============================================================================
+
+static void replacePatch(uint8_t * p, KernelPatch * patch)
+{
+	uint32_t index = 0;
+
+	for (; index < patch->length; index++)
+	{
+		uint8_t mask = patch->replaceMask ? patch->replaceMask[index] : 0xff;
+
+		p[index] = ((p[index] & ~mask) | (patch->replace[index] & mask));
+	}
+
+#if DEBUG_BOOT
+	printf("Kernel patch: %s applied @ 0x%x\n", patch->name ? patch->name : "", (unsigned)p);
+#endif
+}
+
+
+//==============================================================================
+// Returns the offset of the anchor byte (the first byte with a full find mask)
+// or the patch length when the patch has none.
+
+static uint32_t getAnchorOffset(KernelPatch * patch)
+{
+	uint32_t offset = 0;
+
+	while (offset < patch->length && patch->findMask && patch->findMask[offset] != 0xff)
+	{
+		offset++;
+	}
+
+	return offset;
+}
+
+
+//==============================================================================
+// Applies all given section wide patches in a single pass over the section.
+// Each patch has an anchor byte (see getAnchorOffset) and candidates[] tells
+// us which patches have the byte at hand as anchor byte.
+
+static void patchSection(uint8_t * base, uint32_t size, int * patchNumbers, int patchCount)
+{
+	uint32_t candidates[256];
+	uint32_t anchorOffset[MAX_KERNEL_PATCHES];
+	uint32_t replacements[MAX_KERNEL_PATCHES];
+	uint32_t active = 0;
+	uint32_t position, start, mask;
+
+	int index;
+
+	bzero(candidates, sizeof(candidates));
+
+	for (index = 0; index < patchCount; index++)
+	{
+		KernelPatch * patch = &gKernelPatches[patchNumbers[index]];
+
+		anchorOffset[index] = getAnchorOffset(patch);
+
+		// Patches without an anchor byte are rejected by loadKernelPatches().
+		if (anchorOffset[index] < patch->length)
+		{
+			candidates[patch->find[anchorOffset[index]]] |= (1U << index);
+			active |= (1U << index);
+		}
+
+		replacements[index] = 0;
+	}
+
+	for (position = 0; active && position < size; position++)
+	{
+		mask = (candidates[base[position]] & active);
+
+		while (mask)
+		{
+			index = __builtin_ctz(mask);
+			mask &= (mask - 1);
+
+			KernelPatch * patch = &gKernelPatches[patchNumbers[index]];
+
+			if (position < anchorOffset[index])
+			{
+				continue;
+			}
+
+			start = (position - anchorOffset[index]);
+
+			if ((start + patch->length) <= size && matchPatch(base + start, patch))
+			{
+				replacePatch(base + start, patch);
+
+				if (patch->count && ++replacements[index] == patch->count)
+				{
+					active &= ~(1U << index);
+				}
+			}
+		}
+	}
+}
+
+
+//==============================================================================
+// Called from processKernelSymbols() in load.c to collect the anchor symbols.
+
+int getKernelPatchTargets(SymbolTarget * targets, int maxTargets)
+{
+	int index = 0;
+
+#if XCPM_SCOPE_MSRS_PATCH
+	// Only required when MSR_PKG_CST_CONFIG_CONTROL is locked.
+	staticKernelPatches[XCPM_SCOPE_MSRS_PATCH].disabled = (gPlatform.CPU.CstConfigMsrLocked == false);
+#endif
+
+	gAnchoredPatchCount = 0;
+
+	for (; index < gKernelPatchCount; index++)
+	{
+		if (gKernelPatches[index].symbol && !gKernelPatches[index].disabled)
+		{
+			if (gAnchoredPatchCount == maxTargets)
+			{
+				error("Kernel patch %d (%s) ignored (too many symbol anchored patches)\n", index, gKernelPatches[index].name ? gKernelPatches[index].name : "");
+				continue;
+			}
+
+			targets[gAnchoredPatchCount].name = gKernelPatches[index].symbol;
+			targets[gAnchoredPatchCount].section = gKernelPatches[index].symbolSection;
+			gAnchoredPatches[gAnchoredPatchCount++] = index;
+		}
+	}
+
+	return gAnchoredPatchCount;
+}
+
+
+//==============================================================================
+// Called from processKernelSymbols() in load.c after the lookup of the targets
+// returned by getKernelPatchTargets(). Note that the segments are copied to
+// their (masked) vmaddr by now, and thus that is where we patch.
+
+void applyKernelPatches(MachOView * view, SymbolTarget * targets)
+{
+	int index, patchCount, patchNumbers[MAX_KERNEL_PATCHES];
+
+	uint32_t offset, replacements;
+
+	// Symbol anchored patches.
+	for (index = 0; index < gAnchoredPatchCount; index++)
+	{
+		KernelPatch * patch = &gKernelPatches[gAnchoredPatches[index]];
+
+		if (targets[index].found)
+		{
+			uint8_t * p = (uint8_t *)(unsigned long)(targets[index].value & 0x3fffffff);
+
+			for (offset = 0, replacements = 0; offset <= patch->range; offset++)
+			{
+				if (matchPatch(p + offset, patch))
+				{
+					replacePatch(p + offset, patch);
+
+					if (patch->count && ++replacements == patch->count)
+					{
+						break;
+					}
+
+					offset += (patch->length - 1);
+				}
+			}
+		}
+	}
+
+	// Section wide patches.
+	for (offset = 0; offset < view->sectionCount; offset++)
+	{
+		MachOSection * section = &view->sections[offset];
+
+		for (index = 0, patchCount = 0; index < gKernelPatchCount; index++)
+		{
+			KernelPatch * patch = &gKernelPatches[index];
+
+			if (patch->symbol == NULL && !patch->disabled &&
+				strncmp(section->segmentName, patch->segment, 16) == 0 && strncmp(section->sectionName, patch->section, 16) == 0)
+			{
+				patchNumbers[patchCount++] = index;
+			}
+		}
+
+		if (patchCount && section->size)
+		{
+			patchSection((uint8_t *)(unsigned long)(section->addr & 0x3fffffff), (uint32_t)section->size, patchNumbers, patchCount);
+		}
+	}
+}
+
+
+#if LOAD_EXTRA_KERNEL_PATCHES
+//==============================================================================
+// Returns the decoded data of a <data> property, and its length (via length).
+
+static uint8_t * getPatchData(TagPtr dictionary, const char * key, uint32_t * length)
+{
+	unsigned char * data = NULL;
+
+	TagPtr tag = XMLGetProperty(dictionary, key);
+
+	*length = 0;
+
+	if (tag && tag->type == kTagTypeData && tag->string)
+	{
+		int size = base64Decode(tag->string, &data);
+
+		*length = (size > 0) ? size : 0;
+	}
+
+	return data;
+}
+
+
+//==============================================================================
+// Frees the decoded data of a rejected patch.
+
+static void freePatchData(KernelPatch * patch)
+{
+	free((void *)patch->find);
+	free((void *)patch->findMask);
+	free((void *)patch->replace);
+	free((void *)patch->replaceMask);
+}
+
+
+//==============================================================================
+// Returns the value of a (hex or decimal) number stored as <string> property.
+
+static uint32_t getPatchNumber(TagPtr dictionary, const char * key)
+{
+	TagPtr tag = XMLGetProperty(dictionary, key);
+
+	if (tag && tag->type == kTagTypeString && tag->string)
+	{
+		return strtoul(tag->string, NULL, 0);
+	}
+
+	return 0;
+}
+
+
+//==============================================================================
+// Called from boot() in boot.c – must be called before the kernel is loaded,
+// since we use the same load buffer.
+//
+// Example of a section wide patch in /Extra/KernelPatches.plist:
+//
+//	<key>Patches</key>
+//	<array>
+//		<dict>
+//			<key>Name</key>		<string>Example</string>
+//			<key>Segment</key>	<string>__TEXT</string>
+//			<key>Section</key>	<string>__text</string>
+//			<key>Find</key>		<data>...</data>
+//			<key>Mask</key>		<data>...</data> (optional)
+//			<key>Replace</key>	<data>...</data>
+//			<key>Count</key>	<string>1</string> (optional)
+//		</dict>
+//	</array>
+//
+// Use Symbol (string), SymbolSection (string) and Range (string) instead of
+// Segment/Section for symbol anchored patches. Optional keys: ReplaceMask
+// and Disabled (<true/>).
+
+void loadKernelPatches(void)
+{
+	TagPtr dictionary, patches, tag;
+
+	KernelPatch * patch;
+
+	uint32_t length, maskLength;
+
+	int count = 0, entry = 0, anchoredCount = 0;
+
+	long fileSize = LoadFile("/Extra/KernelPatches.plist");
+
+	if (fileSize <= 0)
+	{
+		return;
+	}
+
+	((char *)kLoadAddr)[fileSize] = '\0';
+
+#if BINARY_PLIST_SUPPORT
+	if (XMLIsBinaryPlist((char *)kLoadAddr, fileSize))
+	{
+		fileSize = XMLParseBinaryPlist((char *)kLoadAddr, fileSize, &dictionary);
+	}
+	else
+#endif
+	{
+		fileSize = ParseXMLFileInPlace((char *)kLoadAddr, &dictionary);
+	}
+
+	if (fileSize <= 0)
+	{
+		error("ERROR: failed to parse: /Extra/KernelPatches.plist\n");
+		return;
+	}
+
+	patches = XMLGetProperty(dictionary, "Patches");
+
+	if (patches == NULL || patches->type != kTagTypeArray)
+	{
+		return;
+	}
+
+	for (tag = patches->tag; tag; tag = tag->tagNext)
+	{
+		count++;
+	}
+
+	// Note: Patches are capped at MAX_KERNEL_PATCHES.
+	patch = calloc((MAX_KERNEL_PATCHES + 1), sizeof(KernelPatch));
+
+	if (patch == NULL)
+	{
+		return;
+	}
+	memcpy(patch, gKernelPatches, (gKernelPatchCount * sizeof(KernelPatch)));
+
+	gKernelPatches = patch;
+
+	for (; patch < &gKernelPatches[gKernelPatchCount]; patch++)
+	{
+		anchoredCount += (patch->symbol != NULL);
+	}
+
+	/*
+	 * The strings of the patches point to the (interned) strings of the tags,
+	 * which is why we don't free the dictionary (it is small anyway).
+	 */
+	for (tag = patches->tag; tag && gKernelPatchCount < MAX_KERNEL_PATCHES; tag = tag->tagNext, entry++)
+	{
+		if (tag->type != kTagTypeDict)
+		{
+			continue;
+		}
+
+		TagPtr name = XMLGetProperty(tag, "Name");
+		TagPtr symbol = XMLGetProperty(tag, "Symbol");
+		TagPtr segment = XMLGetProperty(tag, "Segment");
+		TagPtr section = XMLGetProperty(tag, "Section");
+		TagPtr disabled = XMLGetProperty(tag, "Disabled");
+
+		bzero(patch, sizeof(KernelPatch));
+
+		patch->name = (name && name->type == kTagTypeString) ? name->string : NULL;
+		patch->symbol = (symbol && symbol->type == kTagTypeString) ? symbol->string : NULL;
+		patch->symbolSection = getPatchNumber(tag, "SymbolSection");
+		patch->segment = (segment && segment->type == kTagTypeString) ? segment->string : NULL;
+		patch->section = (section && section->type == kTagTypeString) ? section->string : NULL;
+		patch->range = getPatchNumber(tag, "Range");
+		patch->count = getPatchNumber(tag, "Count");
+		patch->disabled = (disabled && disabled->type == kTagTypeTrue);
+
+		patch->find = getPatchData(tag, "Find", &patch->length);
+		patch->replace = getPatchData(tag, "Replace", &length);
+
+		// Sanity checks.
+		if (patch->length == 0 || length != patch->length || (patch->symbol == NULL && (patch->segment == NULL || patch->section == NULL)))
+		{
+			error("Kernel patch %d (%s) ignored (invalid data)\n", entry, patch->name ? patch->name : "");
+			freePatchData(patch);
+			continue;
+		}
+
+		// Symbol anchors are looked up in the same sweep as the version symbols.
+		if (patch->symbol && anchoredCount == MAX_ANCHORED_KERNEL_PATCHES)
+		{
+			error("Kernel patch %d (%s) ignored (too many symbol anchored patches)\n", entry, patch->name ? patch->name : "");
+			freePatchData(patch);
+			continue;
+		}
+
+		patch->findMask = getPatchData(tag, "Mask", &length);
+		patch->replaceMask = getPatchData(tag, "ReplaceMask", &maskLength);
+
+		if ((patch->findMask && length != patch->length) || (patch->replaceMask && maskLength != patch->length))
+		{
+			error("Kernel patch %d (%s) ignored (invalid mask length)\n", entry, patch->name ? patch->name : "");
+			freePatchData(patch);
+			continue;
+		}
+
+		// The section matcher needs at least one byte with a full find mask.
+		if (patch->symbol == NULL && getAnchorOffset(patch) == patch->length)
+		{
+			error("Kernel patch %d (%s) ignored (no fully masked byte)\n", entry, patch->name ? patch->name : "");
+			freePatchData(patch);
+			continue;
+		}
+
+		anchoredCount += (patch->symbol != NULL);
+		gKernelPatchCount++;
+		patch++;
+	}
+
+#if DEBUG_BOOT
+	printf("loadKernelPatches(): %d patches (%d in plist)\n", gKernelPatchCount, count);
+	sleep(1);
+#endif
+}
+#else
+//==============================================================================
+
+void loadKernelPatches(void)
+{
+}
+#endif
@@ -0,0 +1,48 @@
+/*
+ *
+ * kernel_patcher.h
+ *
+ * Declarative find/replace patches for the kernel and prelinked kexts.
+ *
+ */
+
+#ifndef __LIBSAIO_KERNEL_PATCHER_H
+#define __LIBSAIO_KERNEL_PATCHER_H
+
+#include "libsaio.h"
+
+
+#define MAX_KERNEL_PATCHES			32	// Limited by the 32-bit candidate masks used in the section matcher.
+#define MAX_ANCHORED_KERNEL_PATCHES	29	// Limited by lookupSymbols() in load.c (32 targets, including 3 version symbols).
+
+
+//==============================================================================
+// A patch is either anchored to a symbol (searched from the symbol value up to
+// 'range' bytes) or section wide (searched over the whole section). Both types
+// support a find mask (NULL compares all bits) and a replace mask (NULL writes
+// all bytes). The number of replacements can be limited with 'count'.
+
+typedef struct KernelPatch
+{
+	const char *	name;				// Used for debug output only.
+	const char *	symbol;				// Anchor symbol or NULL for section wide patches.
+	uint8_t			symbolSection;		// Required n_sect for the anchor symbol (0 for any).
+	const char *	segment;			// Segment name of section wide patches i.e. "__TEXT"
+	const char *	section;			// Section name of section wide patches i.e. "__text"
+	uint32_t		range;				// Number of bytes to search after the anchor symbol.
+	uint32_t		length;				// Length of the find/replace data.
+	const uint8_t *	find;
+	const uint8_t *	findMask;
+	const uint8_t *	replace;
+	const uint8_t *	replaceMask;
+	uint32_t		count;				// Maximum number of replacements (0 for no limit).
+	bool			disabled;
+} KernelPatch;
+
+
+/* kernel_patcher.c */
+extern void	loadKernelPatches(void);
+extern int	getKernelPatchTargets(SymbolTarget * targets, int maxTargets);
+extern void	applyKernelPatches(MachOView * view, SymbolTarget * targets);
+
+#endif /* !__LIBSAIO_KERNEL_PATCHER_H */
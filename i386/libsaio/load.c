@@ -36,6 +36,7 @@
 
 #include <sl.h>
 #include "platform.h"
+#include "kernel_patcher.h"
 
 /***
  * Backward compatibility fix for the SDK 10.7 version of loader.h
@@ -49,12 +50,13 @@
 bool gLoadKernelDrivers = true;
 
 // Private functions.
-#if (PATCH_KEXT_LOADING && ((MAKE_TARGET_OS & EL_CAPITAN) == EL_CAPITAN))
-	static long patchLoadExecutable(unsigned long cmdBase, long listSize, unsigned long textSegmentAddress, unsigned long vldSegmentAddress);
-#endif
+#define SYMBOL_HASH_SLOTS	64	// Must be a power of two (supports up to 32 target symbols).
+#define SYMBOL_HASH_PREFIX	16	// Number of characters used for the symbol name hash.
 
-static long initKernelVersionInfo(unsigned long cmdbase, long listSize, unsigned int textSegmentAddress);
-static long DecodeSegment(long cmdBase, unsigned int*load_addr, unsigned int *load_size);
+static uint32_t hashSymbolName(const char * name);
+static long processKernelSymbols(void);
+static void initKernelVersionInfo(SymbolTarget * targets);
+static long DecodeSegment(MachOSegment * segment, bool inPlace, unsigned int *load_addr, unsigned int *load_size);
 static long DecodeUnixThread(long cmdBase, unsigned int *entry);
 
 #define ADD_SYMTAB	1
@@ -65,6 +67,12 @@ static long DecodeUnixThread(long cmdBase, unsigned int *entry);
 
 static unsigned long gBinaryAddress;
 
+// Descriptor of the last decoded kernel (see indexMachO).
+static MachOView gMachOView;
+
+// Image address of the last Mach-O that passed the isMachOInPlace() check.
+static unsigned long gInPlaceBinary = 0;
+
 
 //==============================================================================
 // Public function.
@@ -126,139 +134,268 @@ long ThinFatFile(void **binary, unsigned long *length)
 
 
 //==============================================================================
-// Called from DecodeKernel() in drivers.c
+// Public function. Called from DecodeMachO() but can also be used for kexts.
+//
+// Records all segments, sections, and the symtab, dysymtab and entry point
+// commands in a single walk over the load commands, so that nothing else has
+// to walk (or recompute offsets in) the load commands again.
 
-long DecodeMachO(void *binary, entry_t *rentry, char **raddr, int *rsize)
+long indexMachO(void * binary, MachOView * view)
 {
-	long ret						= -1;
-	long sectionNumber				= 0;
+	struct mach_header * machHeader = (struct mach_header *)binary;
 
-	unsigned int vmaddr				= ~0;
-	unsigned int vmend				= 0;
-	unsigned int entry				= 0;
-	unsigned int load_addr			= 0;
-	unsigned int load_size			= 0;
-	unsigned int textSegmentAddress	= 0;
-	unsigned int vldSegmentAddress	= 0;
-
-	unsigned long ncmds				= 0;
-	unsigned long cmdBase			= 0;
-	unsigned long cmd				= 0;
-	unsigned long cmdsize			= 0;
-	unsigned long cmdstart			= 0;
-	unsigned long cnt				= 0;
-	unsigned long listSize			= 0;
+	unsigned long cmdBase	= (unsigned long)binary;
+	unsigned long cmdsize	= 0;
+	unsigned long cnt		= 0;
 
-	gBinaryAddress = (unsigned long)binary;
+	uint32_t index = 0;
 
-	if (gPlatform.ArchCPUType == CPU_TYPE_X86_64)
-	{
-		struct mach_header_64 * machHeader = (struct mach_header_64 *)(gBinaryAddress);
+	bzero(view, sizeof(MachOView));
 
-		if (machHeader->magic != MH_MAGIC_64)
-		{
-			error("Mach-O file(X86_64) has a bad magic number!\n");
-			return -1;
-		}
+	view->binary = binary;
 
-		listSize = sizeof(struct nlist_64);
-		cmdstart = (unsigned long)gBinaryAddress + sizeof(struct mach_header_64);
-#if DEBUG
-		printf("In DecodeMachO()\n");
-		printf("magic:      %x\n", (unsigned)machHeader->magic);
-		printf("cputype:    %x\n", (unsigned)machHeader->cputype);
-		printf("cpusubtype: %x\n", (unsigned)machHeader->cpusubtype);
-		printf("filetype:   %x\n", (unsigned)machHeader->filetype);
-		printf("ncmds:      %x\n", (unsigned)machHeader->ncmds);
-		printf("sizeofcmds: %x\n", (unsigned)machHeader->sizeofcmds);
-		printf("flags:      %x\n", (unsigned)machHeader->flags);
-		sleep(5);
-#endif
-		ncmds = machHeader->ncmds;
+	if (machHeader->magic == MH_MAGIC_64)
+	{
+		view->is64Bit = true;
+		cmdBase += sizeof(struct mach_header_64);
 	}
-	else // if (gPlatform.ArchCPUType == CPU_TYPE_I386)
+	else if (machHeader->magic == MH_MAGIC)
 	{
-		struct mach_header * machHeader = (struct mach_header *)(gBinaryAddress);
-
-		if (machHeader->magic != MH_MAGIC)
-		{
-			error("Mach-O file(i386) has a bad magic number!\n");
-			return -1;
-		}
-
-		listSize = sizeof(struct nlist);
-		cmdstart = (unsigned long)gBinaryAddress + sizeof(struct mach_header);
-#if DEBUG
-		printf("In DecodeMachO()\n");
-		printf("magic:      %x\n", (unsigned)machHeader->magic);
-		printf("cputype:    %x\n", (unsigned)machHeader->cputype);
-		printf("cpusubtype: %x\n", (unsigned)machHeader->cpusubtype);
-		printf("filetype:   %x\n", (unsigned)machHeader->filetype);
-		printf("ncmds:      %x\n", (unsigned)machHeader->ncmds);
-		printf("sizeofcmds: %x\n", (unsigned)machHeader->sizeofcmds);
-		printf("flags:      %x\n", (unsigned)machHeader->flags);
-		sleep(5);
-#endif
-		ncmds = machHeader->ncmds;
+		cmdBase += sizeof(struct mach_header);
+	}
+	else
+	{
+		return -1;
 	}
 
-	cmdBase = cmdstart;
-
-	for (cnt = 0; cnt < ncmds; cnt++)
+	for (; cnt < machHeader->ncmds; cnt++, cmdBase += cmdsize)
 	{
-		cmd = ((long *)cmdBase)[0];
-		cmdsize = ((long *)cmdBase)[1];
+		cmdsize = ((uint32_t *)cmdBase)[1];
 
-		switch (cmd)
+		switch (((uint32_t *)cmdBase)[0])
 		{
-			case LC_SEGMENT:
 			case LC_SEGMENT_64:
-				sectionNumber = DecodeSegment(cmdBase, &load_addr, &load_size);
-
-				if (sectionNumber == 1) // __TEXT,__text
+			case LC_SEGMENT:
+				if (view->segmentCount == MACHO_MAX_SEGMENTS)
 				{
-					textSegmentAddress = cmdBase;
-					ret = 0;
+					error("indexMachO(): too many segments!\n");
+					return -1;
 				}
-				else if (sectionNumber == 25) // __KLD,__text
+
+				MachOSegment * segment = &view->segments[view->segmentCount++];
+
+				if (view->is64Bit)
 				{
-					vldSegmentAddress = cmdBase;
-					ret = 0;
-				}
+					struct segment_command_64 * segCmd = (struct segment_command_64 *)cmdBase;
+					struct section_64 * section = (struct section_64 *)(cmdBase + sizeof(struct segment_command_64));
+
+					segment->name			= segCmd->segname;
+					segment->vmaddr			= segCmd->vmaddr;
+					segment->vmsize			= segCmd->vmsize;
+					segment->fileoff		= segCmd->fileoff;
+					segment->filesize		= segCmd->filesize;
+					segment->firstSection	= view->sectionCount;
 
-				if (load_size != 0 && load_addr >= KERNEL_ADDR)
+					if ((view->sectionCount + segCmd->nsects) > MACHO_MAX_SECTIONS)
+					{
+						error("indexMachO(): too many sections!\n");
+						return -1;
+					}
+
+					for (index = 0; index < segCmd->nsects; index++, section++)
+					{
+						view->sections[view->sectionCount].segmentName = section->segname;
+						view->sections[view->sectionCount].sectionName = section->sectname;
+						view->sections[view->sectionCount].addr = section->addr;
+						view->sections[view->sectionCount++].size = section->size;
+					}
+				}
+				else
 				{
-					vmaddr = min(vmaddr, load_addr);
-					vmend = max(vmend, load_addr + load_size);
+					struct segment_command * segCmd = (struct segment_command *)cmdBase;
+					struct section * section = (struct section *)(cmdBase + sizeof(struct segment_command));
+
+					segment->name			= segCmd->segname;
+					segment->vmaddr			= segCmd->vmaddr;
+					segment->vmsize			= segCmd->vmsize;
+					segment->fileoff		= segCmd->fileoff;
+					segment->filesize		= segCmd->filesize;
+					segment->firstSection	= view->sectionCount;
+
+					if ((view->sectionCount + segCmd->nsects) > MACHO_MAX_SECTIONS)
+					{
+						error("indexMachO(): too many sections!\n");
+						return -1;
+					}
+
+					for (index = 0; index < segCmd->nsects; index++, section++)
+					{
+						view->sections[view->sectionCount].segmentName = section->segname;
+						view->sections[view->sectionCount].sectionName = section->sectname;
+						view->sections[view->sectionCount].addr = section->addr;
+						view->sections[view->sectionCount++].size = section->size;
+					}
 				}
 
+				segment->sectionCount = (view->sectionCount - segment->firstSection);
 				break;
 
 			case LC_SYMTAB:
-				initKernelVersionInfo(cmdBase, listSize, textSegmentAddress);
-#if (PATCH_KEXT_LOADING && ((MAKE_TARGET_OS & EL_CAPITAN) == EL_CAPITAN))
-				patchLoadExecutable(cmdBase, listSize, textSegmentAddress, vldSegmentAddress);
-#endif
+				view->symtabCmd = cmdBase;
+				break;
+
+			case LC_DYSYMTAB:
+				view->dysymtabCmd = cmdBase;
 				break;
 
 			case LC_MAIN:	/* Mountain Lion's replacement for LC_UNIXTHREAD */
 			case LC_UNIXTHREAD:
-				ret = DecodeUnixThread(cmdBase, &entry);
+				view->entryCmd = cmdBase;
 				break;
 
 			default:
 #if NOTDEF
-				printf("Ignoring cmd type %d.\n", (unsigned)cmd);
+				printf("Ignoring cmd type %d.\n", (unsigned)((uint32_t *)cmdBase)[0]);
 #endif
 				break;
 		}
+	}
+
+	return 0;
+}
+
+
+//==============================================================================
+// Public function. Called from decodeKernel() in drivers.c
+//
+// Checks if the (thin) Mach-O image at binary can be used in place. This is the
+// case when all segments that don't already sit at their (masked) vmaddr, can
+// be copied to a location outside of the image. Note that the image must also
+// end before the end of the in place segments, or the symbol table may get
+// overwritten (see DecodeSymbolTable).
+
+bool isMachOInPlace(void * binary, unsigned long length)
+{
+	unsigned long imageStart	= (unsigned long)binary;
+	unsigned long imageEnd		= (imageStart + length);
+	unsigned long vmaddr		= 0;
+	unsigned long vmend			= 0;
+
+	uint32_t index = 0;
+
+	gInPlaceBinary = 0;
+
+	if (indexMachO(binary, &gMachOView) != 0)
+	{
+		return false;
+	}
+
+	for (; index < gMachOView.segmentCount; index++)
+	{
+		MachOSegment * segment = &gMachOView.segments[index];
+
+		if (segment->vmsize && segment->filesize)
+		{
+			vmaddr = (segment->vmaddr & 0x3fffffff);
+
+			if ((imageStart + segment->fileoff) == vmaddr)
+			{
+				vmend = max(vmend, (vmaddr + segment->vmsize));
+			}
+			else if (vmaddr < imageEnd && (vmaddr + segment->vmsize) > imageStart)
+			{
+				return false;
+			}
+		}
+	}
+
+	if (vmend < imageEnd)
+	{
+		return false;
+	}
+
+	gInPlaceBinary = imageStart;
+
+	return true;
+}
 
-		if (ret != 0)
+
+//==============================================================================
+// Called from DecodeKernel() in drivers.c
+
+long DecodeMachO(void *binary, entry_t *rentry, char **raddr, int *rsize)
+{
+	long ret						= -1;
+	long sectionNumber				= 0;
+
+	unsigned int vmaddr				= ~0;
+	unsigned int vmend				= 0;
+	unsigned int entry				= 0;
+	unsigned int load_addr			= 0;
+	unsigned int load_size			= 0;
+
+	unsigned long cnt				= 0;
+
+	struct mach_header * machHeader = (struct mach_header *)binary;
+
+	// Segments that are already at their vmaddr are not copied, and their bss is zeroed last.
+	bool inPlace					= (gInPlaceBinary == (unsigned long)binary);
+
+	gBinaryAddress = (unsigned long)binary;
+
+	if (machHeader->magic != ((gPlatform.ArchCPUType == CPU_TYPE_X86_64) ? MH_MAGIC_64 : MH_MAGIC))
+	{
+		error("Mach-O file(%s) has a bad magic number!\n", (gPlatform.ArchCPUType == CPU_TYPE_X86_64) ? "X86_64" : "i386");
+		return -1;
+	}
+
+#if DEBUG
+	printf("In DecodeMachO()\n");
+	printf("magic:      %x\n", (unsigned)machHeader->magic);
+	printf("cputype:    %x\n", (unsigned)machHeader->cputype);
+	printf("cpusubtype: %x\n", (unsigned)machHeader->cpusubtype);
+	printf("filetype:   %x\n", (unsigned)machHeader->filetype);
+	printf("ncmds:      %x\n", (unsigned)machHeader->ncmds);
+	printf("sizeofcmds: %x\n", (unsigned)machHeader->sizeofcmds);
+	printf("flags:      %x\n", (unsigned)machHeader->flags);
+	sleep(5);
+#endif
+
+	if (indexMachO(binary, &gMachOView) != 0)
+	{
+		return -1;
+	}
+
+	for (cnt = 0; cnt < gMachOView.segmentCount; cnt++)
+	{
+		sectionNumber = DecodeSegment(&gMachOView.segments[cnt], inPlace, &load_addr, &load_size);
+
+		if (sectionNumber == 1 || sectionNumber == 25) // __TEXT,__text or __KLD,__text
 		{
-			return -1;
+			ret = 0;
 		}
 
-		cmdBase += cmdsize;
+		if (load_size != 0 && load_addr >= KERNEL_ADDR)
+		{
+			vmaddr = min(vmaddr, load_addr);
+			vmend = max(vmend, load_addr + load_size);
+		}
+	}
+
+	if (ret == 0 && gMachOView.entryCmd)
+	{
+		ret = DecodeUnixThread(gMachOView.entryCmd, &entry);
+	}
+
+	if (ret != 0)
+	{
+		return -1;
+	}
+
+	// All segments are copied by now, which is required for patching.
+	if (gMachOView.symtabCmd)
+	{
+		processKernelSymbols();
 	}
 
 	*rentry = (entry_t)( (unsigned long) entry & 0x3fffffff );
@@ -266,350 +403,240 @@ long DecodeMachO(void *binary, entry_t *rentry, char **raddr, int *rsize)
 	*raddr = (char *)vmaddr;
 
 #if ADD_SYMTAB
-	cmdBase = cmdstart;
+	if (gMachOView.symtabCmd && DecodeSymbolTable(gMachOView.symtabCmd) != 0)
+	{
+		return -1;
+	}
+#endif
 
-	for (cnt = 0; cnt < ncmds; cnt++)
+	// Nothing reads from the image anymore, so now we can zero the bss of the in place segments.
+	for (cnt = 0; inPlace && cnt < gMachOView.segmentCount; cnt++)
 	{
-		cmd = ((long *)cmdBase)[0];
-		cmdsize = ((long *)cmdBase)[1];
-		
-		if (cmd == LC_SYMTAB)
+		MachOSegment * segment = &gMachOView.segments[cnt];
+
+		if (segment->filesize && segment->vmsize > segment->filesize)
 		{
-			if (DecodeSymbolTable(cmdBase) != 0)
-			{
-				return -1;
-			}
+			bzero((char *)(unsigned long)((segment->vmaddr & 0x3fffffff) + segment->filesize), (segment->vmsize - segment->filesize));
 		}
-
-		cmdBase += cmdsize;
 	}
-#endif
+
+	gInPlaceBinary = 0;
+
 	return ret;
 }
 
-#if (PATCH_KEXT_LOADING && ((MAKE_TARGET_OS & EL_CAPITAN) == EL_CAPITAN))
-
 //==============================================================================
-// Private function. Called from DecodeMachO()
+// Private function. Called from lookupSymbols()
+//
+// FNV-1a hash over (at most) the first SYMBOL_HASH_PREFIX characters. Mangled
+// C++ names are long, and their tails hardly ever differ, so there is no need
+// to hash the full string. Collisions are resolved with strcmp() anyway.
 
-static long patchLoadExecutable(unsigned long cmdBase, long listSize, unsigned long textSegmentAddress, unsigned long vldSegmentAddress)
+static uint32_t hashSymbolName(const char * name)
 {
-#if (DEBUG_BOOT && PATCH_KEXT_LOADING && ((MAKE_TARGET_OS & EL_CAPITAN) == EL_CAPITAN))
-	printf("patchLoadExecutable() called\n");
-	sleep(1);
-#endif
+	uint32_t hash = 2166136261UL;
+	int index = 0;
 
+	for (; name[index] && index < SYMBOL_HASH_PREFIX; index++)
+	{
+		hash = ((hash ^ (uint8_t)name[index]) * 16777619UL);
+	}
+
+	return hash;
+}
+
+
+//==============================================================================
+// Public function. Called from DecodeMachO() but can also be used for kexts.
+//
+// Looks up all target symbols in a single sweep over the symbol table. Target
+// names are stored in a small open addressing hash table, so that each symbol
+// costs one (bounded) hash calculation instead of a strcmp() per target. When
+// a LC_DYSYMTAB is available we only visit the local and external defined
+// symbol ranges (undefined symbols are skipped). The sweep stops as soon as
+// all targets are found. Returns the number of symbols found, or -1 on error.
+
+long lookupSymbols(MachOView * view, SymbolTarget * targets, int targetCount)
+{
+	struct symtab_command * symtab = (struct symtab_command *)view->symtabCmd;
+	struct dysymtab_command * dysymtab = (struct dysymtab_command *)view->dysymtabCmd;
+
+	char * binary = (char *)view->binary;
+
+	bool is64Bit = view->is64Bit;
+
+	uint8_t slots[SYMBOL_HASH_SLOTS]; // Target index + 1 (0 marks an empty slot).
+
+	uint32_t ranges[2][2];
+	uint32_t hash, slot, symbolNumber, lastSymbol;
+
+	char * stringTable = NULL;
 	char * symbolName = NULL;
 
-	// Skip the first 3000 symbols, to speed up the search process.
-	int skippedSymbolCount	= 0; // (3000 * listSize);
+	long listSize = is64Bit ? sizeof(struct nlist_64) : sizeof(struct nlist);
+	long found = 0;
 
-	long symbolNumber		= 0;
+	int index, rangeCount = 1;
 
-	struct symtab_command * symtab = (struct symtab_command *)cmdBase;
-	struct segment_command_64 * textSegment = (struct segment_command_64 *)textSegmentAddress;
-	// struct segment_command_64 * vldSegment = (struct segment_command_64 *)vldSegmentAddress;
+	if (symtab == NULL || targetCount <= 0 || targetCount > (SYMBOL_HASH_SLOTS / 2))
+	{
+		return -1;
+	}
 
-	void * stringTable = (void *)(gBinaryAddress + symtab->stroff);
+	stringTable = binary + symtab->stroff;
 
-	uint32_t pointer = (gBinaryAddress + symtab->symoff + skippedSymbolCount);
+	bzero(slots, sizeof(slots));
 
-	while (symbolNumber < symtab->nsyms)
+	for (index = 0; index < targetCount; index++)
 	{
-		struct nlist_64 * nl = (struct nlist_64 *)pointer;
+		targets[index].found = false;
+		targets[index].value = 0;
+		targets[index].hash = hashSymbolName(targets[index].name);
 
-#if PATCH_KEXT_LOADING
-		if ((nl->n_sect == 1 /* __TEXT,__text */) && nl->n_value)
+		slot = (targets[index].hash & (SYMBOL_HASH_SLOTS - 1));
+
+		while (slots[slot])
 		{
-			symbolName = (char *)stringTable + nl->n_un.n_strx;
+			slot = ((slot + 1) & (SYMBOL_HASH_SLOTS - 1));
+		}
 
-			if (strcmp(symbolName, "__ZN6OSKext14loadExecutableEv") == 0)
-			{
-				int64_t offset = (nl->n_value - textSegment->vmaddr);
-				uint64_t startAddress = (uint64_t)(textSegment->vmaddr + offset);
-				uint64_t endAddress = (startAddress + 0x300);
+		slots[slot] = (index + 1);
+	}
 
-				/* printf("__ZN6OSKext14loadExecutableEv found!\n");
- 				printf("offset..............: 0x%llx\n", offset);
-				printf("textSegment->vmaddr.: 0x%llx\n", textSegment->vmaddr);
-				printf("textSegment->fileoff: 0x%llx\n", textSegment->fileoff);
-				printf("startAddress........: 0x%llx\n", startAddress);
-				printf("endAddress..........: 0x%llx\n", endAddress);
-				sleep(5); */
+	if (dysymtab)
+	{
+		// Symbols are sorted: local symbols first, then external defined symbols, undefined symbols last.
+		ranges[0][0] = dysymtab->ilocalsym;
+		ranges[0][1] = dysymtab->ilocalsym + dysymtab->nlocalsym;
+		ranges[1][0] = dysymtab->iextdefsym;
+		ranges[1][1] = dysymtab->iextdefsym + dysymtab->nextdefsym;
+		rangeCount = 2;
+	}
+	else
+	{
+		ranges[0][0] = 0;
+		ranges[0][1] = symtab->nsyms;
+	}
 
-				unsigned char * p = (unsigned char *)startAddress;
+	for (index = 0; index < rangeCount; index++)
+	{
+		lastSymbol = min(ranges[index][1], symtab->nsyms);
 
-				for (; p <= (unsigned char *)endAddress; p++)
-				{
-					if (*(uint64_t *)p == LOAD_EXECUTABLE_TARGET_UINT64)
-					{
-						/* printf("Found @ 0x%llx ", (uint64_t)p - startAddress);
-						printf("Symbol-number: %ld\n", (symbolNumber + (skippedSymbolCount / listSize) + 1));
-						sleep(3); */
+		for (symbolNumber = ranges[index][0]; symbolNumber < lastSymbol; symbolNumber++)
+		{
+			// Note: n_strx, n_type and n_sect are at the same offsets for nlist and nlist_64.
+			struct nlist * nl = (struct nlist *)(binary + symtab->symoff + (symbolNumber * listSize));
 
-						*(uint64_t *)p = LOAD_EXECUTABLE_PATCH_UINT64;
-						p = (unsigned char *)endAddress;
-					}
-				}
+			// Skip debugger, undefined and absolute symbols.
+			if ((nl->n_type & (N_STAB | N_TYPE)) != N_SECT)
+			{
+				continue;
 			}
-		}
-#endif
 
-#if PATCH_XCPI_SCOPE_MSRS
-	#if PATCH_KEXT_LOADING
-		else
-	#endif
-		if (((nl->n_sect == 8 /* __DATA,__data */) && nl->n_value) && gPlatform.CPU.CstConfigMsrLocked)
-		{
-			symbolName = (char *)stringTable + nl->n_un.n_strx;
-		
-			if (strcmp(symbolName, "_xcpm_core_scope_msrs") == 0)
+			symbolName = stringTable + nl->n_un.n_strx;
+			hash = hashSymbolName(symbolName);
+
+			for (slot = (hash & (SYMBOL_HASH_SLOTS - 1)); slots[slot]; slot = ((slot + 1) & (SYMBOL_HASH_SLOTS - 1)))
 			{
-				int64_t offset = (nl->n_value - textSegment->vmaddr);
-				uint64_t startAddress = (uint64_t)(textSegment->vmaddr + offset);
-				uint64_t endAddress = (startAddress + 0x3f);
-
-				/* printf("_xcpm_core_scope_msrs found!\n");
-				printf("offset..............: 0x%llx\n", offset);
-				printf("textSegment->vmaddr.: 0x%llx\n", textSegment->vmaddr);
-				printf("textSegment->fileoff: 0x%llx\n", textSegment->fileoff);
-				printf("startAddress........: 0x%llx\n", startAddress);
-				printf("endAddress..........: 0x%llx\n", endAddress);
-				sleep(5); */
-
-				unsigned char * p = (unsigned char *)startAddress;
-				
-				for (; p <= (unsigned char *)endAddress; p++)
+				SymbolTarget * target = &targets[slots[slot] - 1];
+
+				if (target->found || target->hash != hash)
 				{
-					// Note: We don't really need this check.
-					if (*(uint64_t *)p == XCPM_SCOPE_MSRS_TARGET_UINT64)
-					{
-						/* printf("Found @ 0x%llx ", (uint64_t)p - startAddress);
-						printf("Symbol-number: %ld\n", (symbolNumber + (skippedSymbolCount / listSize) + 1));
-						sleep(3); */
-						
-						*(uint64_t *)p = 0x0000000000000000ULL;
-						p += 0x30;
-						*(uint64_t *)p = 0x0000000000000000ULL;
-						p += 0x30;
-						*(uint64_t *)p = 0x0000000000000000ULL;
-						p = (unsigned char *)endAddress;
-					}
+					continue;
 				}
-			}
-		}
-#endif
 
-#if PATCH_LOAD_EXTRA_KEXTS
-	#if (PATCH_KEXT_LOADING || PATCH_XCPI_SCOPE_MSRS)
-		else
-	#endif
-		if ((nl->n_sect == 25 /* __KLD,__text */) && nl->n_value)
-		{
-			symbolName = (char *)stringTable + nl->n_un.n_strx;
-			
-			if (strcmp(symbolName, "__ZN12KLDBootstrap21readStartupExtensionsEv") == 0)
-			{
-				int64_t offset = (nl->n_value - textSegment->vmaddr);
-				uint64_t startAddress = (uint64_t)(textSegment->vmaddr + offset);
-				uint64_t endAddress = (startAddress + 0x3f);
-				
-				/* printf("__ZN12KLDBootstrap21readStartupExtensionsEv found!\n");
-				printf("offset..............: 0x%llx\n", offset);
-				printf("vldSegment->vmaddr..: 0x%llx\n", vldSegment->vmaddr);
-				printf("vldSegment->fileoff.: 0x%llx\n", vldSegment->fileoff);
-				printf("startAddress........: 0x%llx\n", startAddress);
-				printf("endAddress..........: 0x%llx\n", endAddress);
-				sleep(5); */
- 
-				unsigned char * p = (unsigned char *)startAddress;
-				
-				for (; p <= (unsigned char *)endAddress; p++)
+				if ((target->section == 0 || target->section == nl->n_sect) && strcmp(symbolName, target->name) == 0)
 				{
-					if (*(uint64_t *)p == READ_STARTUP_EXTENSIONS_TARGET_UINT64)
+					target->found = true;
+					target->value = is64Bit ? ((struct nlist_64 *)nl)->n_value : nl->n_value;
+
+					if (++found == targetCount)
 					{
-						/* printf("Found @ 0x%llx ", (uint64_t)p - startAddress);
-						printf("Symbol-number: %ld\n", (symbolNumber + (skippedSymbolCount / listSize) + 1));
-						sleep(3); */
-						
-						*(uint64_t *)p = READ_STARTUP_EXTENSIONS_PATCH_UINT64;
-						p = (unsigned char *)endAddress;
+						return found;
 					}
 				}
 			}
 		}
-#endif
-		symbolNumber++;
-		pointer += listSize; // Point to next symbol.
 	}
 
-	return 0;
+	return found;
 }
-#endif
+
 
 //==============================================================================
 // Private function. Called from DecodeMachO()
+//
+// Collects all kernel symbols that we are interested in, and looks them up in
+// one go. Note that this must be called after all segments are copied.
 
-static long initKernelVersionInfo(unsigned long cmdBase, long listSize, unsigned int textSegmentVMAddress)
+static long processKernelSymbols(void)
 {
-	struct symtab_command * symtab = (struct symtab_command *)cmdBase;
-
-	/*
-	 * Reverse search is quicker for symbols at the end of the symbol table (example with 20496 symbols):
-	 *
-	 * _version_revision	is symbol 18865 – first target symbol, iterated symbols: 1631
-	 * _version_minor		is symbol 18863 – second target symbol, iterated symbols: 1633
-	 * _version_major		is symbol 18862 – last target symbol, iterated symbols: 1634
-	 *
-	 * versus:
-	 *
-	 * _version_major		is symbol 18862 – first target symbol, iterated symbols: 18862
-	 * _version_minor		is symbol 18863 – ssecond target symbol, iterated symbols: 18863
-	 * _version_revision	is symbol 18865 – last target symbol, iterated symbols: 18865
-	 */
-
-	const char * targetSymbols[] = { "_version_revision", "_version_minor", "_version_major" };
+	SymbolTarget targets[SYMBOL_HASH_SLOTS / 2] =
+	{
+		{ "_version_major",		2 /* __TEXT,__const */ },
+		{ "_version_minor",		2 /* __TEXT,__const */ },
+		{ "_version_revision",	2 /* __TEXT,__const */ },
+	};
 
-	char * symbolName = NULL;
-	char * loadBuffer = (char *)gBinaryAddress;
+	// The anchor symbols of the kernel patches are looked up in the same sweep.
+	int targetCount = 3 + getKernelPatchTargets(&targets[3], MAX_ANCHORED_KERNEL_PATCHES);
 
-	void * stringTable = (void *)(gBinaryAddress + symtab->stroff);
+	if (lookupSymbols(&gMachOView, targets, targetCount) < 0)
+	{
+		return -1;
+	}
+
+	initKernelVersionInfo(&targets[0]);
 
-	short index								= 0;
+	// Section wide patches don't need any symbols.
+	applyKernelPatches(&gMachOView, &targets[3]);
 
-	long symbolOffset						= 0;
-	long symbolLength						= 0;
-	long symbolNumber						= symtab->nsyms;
+	return 0;
+}
 
-	uint32_t pointer = gBinaryAddress + symtab->symoff + ((symtab->nsyms - 1) * listSize);
 
-#if ((MAKE_TARGET_OS & SNOW_LEOPARD) == SNOW_LEOPARD)
-	if (gPlatform.ArchCPUType == CPU_TYPE_X86_64)
+//==============================================================================
+// Private function. Called from processKernelSymbols()
+
+static void initKernelVersionInfo(SymbolTarget * targets)
+{
+	// Note: The __TEXT segment is already copied to its (masked) vmaddr.
+	if (targets[0].found)
 	{
-#endif
-		struct nlist_64 * nl = (struct nlist_64 *)pointer;
-	
-		while (symbolNumber > 0)
-		{
-			nl = (struct nlist_64 *)pointer;
-			
-			if ((nl->n_sect == 2 /* __TEXT,__const */) && nl->n_value)
-			{
-				symbolName = (char *)stringTable + nl->n_un.n_strx;
-				symbolLength = strlen(symbolName);
-				symbolOffset = (nl->n_value - textSegmentVMAddress);
-				
-				if (symbolLength && (strcmp(symbolName, targetSymbols[index]) == 0))
-				{
-					switch(index)
-					{
-						case 0:
-							gPlatform.KERNEL.versionRevision = (uint8_t)loadBuffer[symbolOffset];
-							index++;
-							break;
-							
-						case 1:
-							gPlatform.KERNEL.versionMinor = (uint8_t)loadBuffer[symbolOffset];
-							index++;
-							break;
-							
-						case 2:
-							gPlatform.KERNEL.versionMajor = (uint8_t)loadBuffer[symbolOffset];
-							symbolNumber = 0;
-							break;
-					}
-				}
-			}
-			
-			symbolNumber--;
-			pointer -= listSize;
-		}
-#if ((MAKE_TARGET_OS & SNOW_LEOPARD) == SNOW_LEOPARD)
+		gPlatform.KERNEL.versionMajor = *(uint8_t *)(unsigned long)(targets[0].value & 0x3fffffff);
 	}
-	else // 32-bit compatibility code.
+
+	if (targets[1].found)
 	{
-		struct nlist * nl = (struct nlist *)pointer;
-		
-		while (symbolNumber > 0)
-		{
-			nl = (struct nlist *)pointer;
-			
-			if ((nl->n_sect == 2 /* __TEXT,__const */) && nl->n_value)
-			{
-				symbolName = (char *)stringTable + nl->n_un.n_strx;
-				symbolLength = strlen(symbolName);
-				symbolOffset = (nl->n_value - textSegmentVMAddress);
-				
-				if (symbolLength && (strcmp(symbolName, targetSymbols[index]) == 0))
-				{
-					switch(index)
-					{
-						case 0:
-							gPlatform.KERNEL.versionRevision = (uint8_t)loadBuffer[symbolOffset];
-							index++;
-							break;
-							
-						case 1:
-							gPlatform.KERNEL.versionMinor = (uint8_t)loadBuffer[symbolOffset];
-							index++;
-							break;
-							
-						case 2:
-							gPlatform.KERNEL.versionMajor = (uint8_t)loadBuffer[symbolOffset];
-							symbolNumber = 0;
-							break;
-					}
-				}
-			}
-			
-			symbolNumber--;
-			pointer -= listSize;
-		}
+		gPlatform.KERNEL.versionMinor = *(uint8_t *)(unsigned long)(targets[1].value & 0x3fffffff);
+	}
+
+	if (targets[2].found)
+	{
+		gPlatform.KERNEL.versionRevision = *(uint8_t *)(unsigned long)(targets[2].value & 0x3fffffff);
 	}
-#endif
 
 #if DEBUG
 	printf("gPlatform.KERNEL.versionMmR: %d.%d.%d\n", gPlatform.KERNEL.versionMajor, gPlatform.KERNEL.versionMinor, gPlatform.KERNEL.versionRevision);
 	sleep(5);
 #endif
-
-	return 0;
 }
 
 //==============================================================================
 // Private function. Called from DecodeMachO()
 // Refactoring and segment name fix for OS X 10.6+ by DHP in 2010.
 
-static long DecodeSegment(long cmdBase, unsigned int *load_addr, unsigned int *load_size)
+static long DecodeSegment(MachOSegment * segment, bool inPlace, unsigned int *load_addr, unsigned int *load_size)
 {
-	char *segmentName	= NULL;
+	const char *segmentName	= segment->name;
 
 	long retValue		= 0;
-	long vmsize			= 0;
-	long filesize		= 0;
+	long vmsize			= segment->vmsize;
+	long filesize		= segment->filesize;
 
-	unsigned long vmaddr		= 0;
-	unsigned long fileAddress	= 0;
+	unsigned long vmaddr		= (segment->vmaddr & 0x3fffffff);
+	unsigned long fileAddress	= (gBinaryAddress + segment->fileoff);
 
-	if (((long *)cmdBase)[0] == LC_SEGMENT_64)
-	{
-		struct segment_command_64 *segCmd = (struct segment_command_64 *)cmdBase;
-		vmaddr			= (segCmd->vmaddr & 0x3fffffff);
-		vmsize			= segCmd->vmsize;
-		fileAddress		= (gBinaryAddress + segCmd->fileoff);
-		filesize		= segCmd->filesize;
-		segmentName		= segCmd->segname;
-	}
-	else
-	{
-		struct segment_command *segCmd = (struct segment_command *)cmdBase;
-		vmaddr			= (segCmd->vmaddr & 0x3fffffff);
-		vmsize			= segCmd->vmsize;
-		fileAddress		= (gBinaryAddress + segCmd->fileoff);
-		filesize		= segCmd->filesize;
-		segmentName		= segCmd->segname;
-	}
-	
 	// Pre-flight checks.
 	if (vmsize && filesize)
 	{
@@ -643,14 +670,14 @@ static long DecodeSegment(long cmdBase, unsigned int *load_addr, unsigned int *l
 			retValue = 25;
 		}
 
-		// Copy from file load area.
-		if (filesize > 0)
+		// Copy from file load area (unless the segment is already in place).
+		if (filesize > 0 && fileAddress != vmaddr)
 		{
 			bcopy((char *)fileAddress, (char *)vmaddr, vmsize > filesize ? filesize : vmsize);
 		}
 
-		// Zero space at the end of the segment.
-		if (vmsize > filesize)
+		// Zero space at the end of the segment (done by DecodeMachO for in place images).
+		if (vmsize > filesize && !inPlace)
 		{
 			bzero((char *)(vmaddr + filesize), vmsize - filesize);
 		}
@@ -0,0 +1,246 @@
+/*
+ *
+ * prefetch.c
+ *
+ * Boot I/O trace (in the spirit of BootCache). Biosread() records the sectors
+ * that it reads from disk, which are exported as the boot-io-trace property of
+ * /RevoEFI. Saved as /Extra/BootIOTrace.bin the trace is used at the next boot
+ * by prefetchBootIOTrace() which sorts the ranges, merges them into contiguous
+ * runs and reads these back-to-back, so that the (random) reads of the catalog
+ * walk and kext loading can be served from memory. Save it with:
+ *
+ * ioreg -p IODeviceTree -n RevoEFI -r -a | plutil -extract 0.boot-io-trace raw -o - - | base64 -D > /Extra/BootIOTrace.bin
+ *
+ */
+
+#include "libsaio.h"
+#include "bootstruct.h"
+#include "platform.h"
+#include "device_tree.h"
+
+#if BOOT_IO_TRACE
+
+#define BOOT_IO_TRACE_FILE		"/Extra/BootIOTrace.bin"
+#define PREFETCH_BUFFER_SIZE	0x01000000		// 16 MB.
+#define PREFETCH_SECTOR_SIZE	512
+#define PREFETCH_CHUNK			(BIOS_LEN / PREFETCH_SECTOR_SIZE)	// Sectors per EBIOS call.
+
+// Runs are sorted on biosdev and then on (64-bit) sector.
+#define RUN_AFTER(run, dev, lba)	(((run)->biosdev > (dev)) || (((run)->biosdev == (dev)) && ((run)->sector > (lba))))
+
+
+typedef struct PrefetchRun
+{
+	uint64_t	sector;
+	uint32_t	count;
+	uint32_t	offset;			// Start of the data in gPrefetchBuffer (in sectors).
+	int			biosdev;
+} PrefetchRun;
+
+
+static BootIOTrace	gBootIOTrace;				// Reads of this boot.
+
+static PrefetchRun	* gPrefetchRuns		= NULL;	// Sorted by biosdev and sector.
+static uint32_t		gPrefetchRunCount	= 0;
+static char			* gPrefetchBuffer	= NULL;
+
+
+//==============================================================================
+// Called by Biosread() for every track read (also for the ones that are served
+// from the prefetched data, so that the trace stays complete).
+
+void recordDiskRead(int biosdev, uint64_t sector, uint32_t count)
+{
+	BootIORange * range = &gBootIOTrace.ranges[gBootIOTrace.count];
+
+	// Extend the previous range for sequential reads.
+	if (gBootIOTrace.count && (range[-1].biosdev == biosdev) &&
+		((range[-1].sector + range[-1].count) == sector) && ((range[-1].count + count) <= 0xFFFF))
+	{
+		range[-1].count += count;
+	}
+	else if (gBootIOTrace.count < BOOT_IO_TRACE_RANGES)
+	{
+		range->sector	= sector;
+		range->count	= count;
+		range->biosdev	= biosdev;
+
+		gBootIOTrace.count++;
+	}
+}
+
+
+//==============================================================================
+// Copies the sectors to 'buffer' when they were prefetched. Returns false when
+// (part of) the sectors are not.
+
+bool readPrefetched(int biosdev, uint64_t sector, uint32_t count, char * buffer)
+{
+	uint32_t middle, low = 0, high = gPrefetchRunCount;
+
+	// Find the last run that starts at (or before) the first sector.
+	while (low < high)
+	{
+		middle = ((low + high) / 2);
+
+		if (!RUN_AFTER(&gPrefetchRuns[middle], biosdev, sector))
+		{
+			low = (middle + 1);
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	if (low == 0)
+	{
+		return false;
+	}
+
+	PrefetchRun * run = &gPrefetchRuns[low - 1];
+
+	if ((run->biosdev != biosdev) || ((sector + count) > (run->sector + run->count)))
+	{
+		return false;
+	}
+
+	bcopy((gPrefetchBuffer + ((run->offset + (sector - run->sector)) * PREFETCH_SECTOR_SIZE)), buffer, (count * PREFETCH_SECTOR_SIZE));
+
+	return true;
+}
+
+
+//==============================================================================
+// Called from boot() right after initPartitionChain().
+
+void prefetchBootIOTrace(void)
+{
+	long flags, time;
+	uint32_t i, j, sectors, runCount = 0;
+
+	BVRef bootVolume = gPlatform.BootVolume;
+	BootIOTrace * trace = (BootIOTrace *)kLoadAddr;
+
+	long length = LoadFile(BOOT_IO_TRACE_FILE);
+
+	if ((bootVolume == NULL) || (length < (long)offsetof(BootIOTrace, ranges)) || (trace->signature != BOOT_IO_TRACE_SIGNATURE) ||
+		(trace->count > BOOT_IO_TRACE_RANGES) || (length < (long)(offsetof(BootIOTrace, ranges) + (trace->count * sizeof(BootIORange)))))
+	{
+		return;
+	}
+
+	/*
+	 * The trace is stale when it was recorded for another volume, or when the
+	 * kernelcache (rebuilt after kext changes) or the Extensions folder has been
+	 * modified after the boot volume modification time stored in it.
+	 */
+	if ((trace->partitionOffset != bootVolume->part_boff) ||
+		((GetFileInfo(kKernelCachePath, kKernelCache, &flags, &time) == 0) && ((uint32_t)time > trace->modTime)) ||
+		((GetFileInfo("/System/Library/", "Extensions", &flags, &time) == 0) && ((uint32_t)time > trace->modTime)))
+	{
+		verbose("Ignoring stale %s\n", BOOT_IO_TRACE_FILE);
+		return;
+	}
+
+	PrefetchRun * runs = (PrefetchRun *)malloc(trace->count * sizeof(PrefetchRun));
+
+	if (runs == NULL)
+	{
+		return;
+	}
+
+	// Insertion sort (on biosdev and sector) of the ranges.
+	for (i = 0; i < trace->count; i++)
+	{
+		BootIORange * range = &trace->ranges[i];
+
+		for (j = i; (j > 0) && RUN_AFTER(&runs[j - 1], range->biosdev, range->sector); j--)
+		{
+			runs[j] = runs[j - 1];
+		}
+
+		runs[j].sector	= range->sector;
+		runs[j].count	= range->count;
+		runs[j].biosdev	= range->biosdev;
+	}
+
+	// Merge overlapping and adjacent ranges into runs (limited by the buffer size).
+	for (i = 0, sectors = 0; (i < trace->count) && (sectors < (PREFETCH_BUFFER_SIZE / PREFETCH_SECTOR_SIZE)); i++)
+	{
+		PrefetchRun * run = runCount ? &runs[runCount - 1] : NULL;
+
+		if (run && (run->biosdev == runs[i].biosdev) && (runs[i].sector <= (run->sector + run->count)))
+		{
+			if ((runs[i].sector + runs[i].count) > (run->sector + run->count))
+			{
+				sectors += ((runs[i].sector + runs[i].count) - (run->sector + run->count));
+				run->count = ((runs[i].sector + runs[i].count) - run->sector);
+			}
+		}
+		else
+		{
+			runs[runCount] = runs[i];
+			runs[runCount].offset = sectors;
+			sectors += runs[i].count;
+			runCount++;
+		}
+	}
+
+	if (sectors > (PREFETCH_BUFFER_SIZE / PREFETCH_SECTOR_SIZE))
+	{
+		runs[runCount - 1].count -= (sectors - (PREFETCH_BUFFER_SIZE / PREFETCH_SECTOR_SIZE));
+		sectors = (PREFETCH_BUFFER_SIZE / PREFETCH_SECTOR_SIZE);
+	}
+
+	char * buffer = (char *)malloc(sectors * PREFETCH_SECTOR_SIZE);
+
+	if (buffer == NULL)
+	{
+		free(runs);
+		return;
+	}
+
+	// Read the runs in LBA order (the runs that fail to read are cut short).
+	for (i = 0; i < runCount; i++)
+	{
+		for (j = 0; j < runs[i].count; j += length)
+		{
+			length = ((runs[i].count - j) < PREFETCH_CHUNK) ? (runs[i].count - j) : PREFETCH_CHUNK;
+
+			if (readDiskSectors(runs[i].biosdev, (runs[i].sector + j), length, (buffer + ((runs[i].offset + j) * PREFETCH_SECTOR_SIZE))) != 0)
+			{
+				runs[i].count = j;
+				break;
+			}
+		}
+	}
+
+	gPrefetchRuns = runs;
+	gPrefetchBuffer = buffer;
+	gPrefetchRunCount = runCount;
+
+	_DISK_DEBUG_DUMP("Prefetched %d sectors in %d runs (%d ranges).\n", sectors, runCount, trace->count);
+}
+
+
+//==============================================================================
+// Called from finalizeKernelBootConfig() in bootstruct.c (before the device
+// tree is flattened).
+
+void exportBootIOTrace(void)
+{
+	Node * node = DT__FindNode("/RevoEFI", true);
+
+	if (node && gPlatform.BootVolume && gBootIOTrace.count)
+	{
+		gBootIOTrace.signature = BOOT_IO_TRACE_SIGNATURE;
+		gBootIOTrace.modTime = gPlatform.BootVolume->modTime;
+		gBootIOTrace.partitionOffset = gPlatform.BootVolume->part_boff;
+
+		// The property data is copied when the device tree is flattened.
+		DT__AddProperty(node, "boot-io-trace", (offsetof(BootIOTrace, ranges) + (gBootIOTrace.count * sizeof(BootIORange))), &gBootIOTrace);
+	}
+}
+
+#endif /* BOOT_IO_TRACE */
@@ -0,0 +1,116 @@
+/*
+ *
+ * profiler.c
+ *
+ * Records the start of each boot phase (time stamp counter) in a fixed ring,
+ * which is handed over to the kernel so that we get a per phase breakdown for
+ * every boot. Use BOOT_PHASE(kBootPhaseXXX) to add a trace point.
+ *
+ * With IO_STATISTICS the I/O counters (see IO_STAT) are kept per boot phase.
+ *
+ */
+
+#include "libsaio.h"
+#include "bootstruct.h"
+#include "platform.h"
+#include "device_tree.h"
+#include "cpu/proc_reg.h"
+
+#if (BOOT_PROFILER || IO_STATISTICS)
+
+#if BOOT_PROFILER
+	static BootProfile gBootProfile;
+#endif
+
+#if IO_STATISTICS
+	uint32_t	gBootPhase = kBootPhaseNone;
+	IOStats		gIOStats[kBootPhaseCount];
+#endif
+
+
+//==============================================================================
+
+void recordBootPhase(uint32_t phase)
+{
+#if IO_STATISTICS
+	gBootPhase = (phase < kBootPhaseCount) ? phase : kBootPhaseNone;
+#endif
+
+#if BOOT_PROFILER
+	BootProfileEntry * entry = &gBootProfile.entries[gBootProfile.count++ % BOOT_PROFILE_ENTRIES];
+
+	entry->tsc = rdtsc64();
+	entry->phase = phase;
+	entry->reserved = 0;
+#endif
+}
+
+
+//==============================================================================
+// Called from finalizeKernelBootConfig() in bootstruct.c (before the device
+// tree is flattened).
+
+void exportBootProfile(void)
+{
+	recordBootPhase(kBootPhaseFinalize);
+
+	Node * node = DT__FindNode("/RevoEFI", true);
+
+#if BOOT_PROFILER
+	gBootProfile.signature = BOOT_PROFILE_SIGNATURE;
+	gBootProfile.tscFrequency = gPlatform.CPU.TSCFrequency;
+
+	long address = AllocateKernelMemory(sizeof(BootProfile));
+	BootProfile * profile = (BootProfile *)address;
+
+	memcpy(profile, &gBootProfile, sizeof(BootProfile));
+
+	bootArgs->performanceDataStart	= (uint32_t)address;
+	bootArgs->performanceDataSize	= sizeof(BootProfile);
+
+	if (node)
+	{
+		DT__AddProperty(node, "boot-phases", sizeof(BootProfile), profile);
+	}
+
+#if DEBUG_BOOT
+	uint32_t i, first = (profile->count > BOOT_PROFILE_ENTRIES) ? (profile->count - BOOT_PROFILE_ENTRIES) : 0;
+	uint32_t ticksPerMS = (uint32_t)(profile->tscFrequency / 1000);
+
+	for (i = first; (i + 1) < profile->count && ticksPerMS; i++)
+	{
+		BootProfileEntry * entry = &profile->entries[i % BOOT_PROFILE_ENTRIES];
+		BootProfileEntry * next = &profile->entries[(i + 1) % BOOT_PROFILE_ENTRIES];
+
+		printf("Phase %2d: %d ms\n", entry->phase, (uint32_t)((next->tsc - entry->tsc) / ticksPerMS));
+	}
+#endif
+#endif /* BOOT_PROFILER */
+
+#if IO_STATISTICS
+	if (node)
+	{
+		// The property data is copied when the device tree is flattened.
+		DT__AddProperty(node, "io-stats", sizeof(gIOStats), gIOStats);
+	}
+
+#if DEBUG_BOOT
+	uint32_t phase;
+
+	for (phase = kBootPhaseNone; phase < kBootPhaseCount; phase++)
+	{
+		IOStats * stats = &gIOStats[phase];
+
+		if (stats->biosCalls || stats->trackCacheHits || stats->blockCacheHits || stats->bytesCopied)
+		{
+			printf("Phase %2d: %d calls, %d sectors, %d retries, %d ECC, %d/%d/%d track/block hits/misses, "
+				   "%d/%d catalog/extents nodes, %d bytes\n", phase, stats->biosCalls, stats->sectorsRead,
+				   stats->retries, stats->eccCorrected, stats->trackCacheHits, stats->blockCacheHits,
+				   stats->blockCacheMisses, stats->btreeNodeReads[0], stats->btreeNodeReads[1], stats->bytesCopied);
+		}
+	}
+#endif
+#endif /* IO_STATISTICS */
+}
+
+#endif /* BOOT_PROFILER || IO_STATISTICS */
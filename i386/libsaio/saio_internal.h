@@ -106,6 +106,9 @@ extern void		stop(const char *format, ...);
 
 /* disk.c */
 extern int		testBiosread(int biosdev, unsigned long long secno);
+#if BOOT_IO_TRACE
+extern int		readDiskSectors(int biosdev, unsigned long long secno, unsigned int count, void * buffer);
+#endif
 extern BVRef	diskScanBootVolumes(int biosdev, int *count);
 extern BVRef	diskScanGPTBootVolumes(int biosdev, int *count);
 extern void		diskSeek(BVRef bvr, long long position);
@@ -146,7 +149,10 @@ extern void		utf_decodestr(const u_int8_t *utf8p, u_int16_t *ucsp, u_int16_t *uc
 /* load.c */
 extern bool		gLoadKernelDrivers;
 extern long		ThinFatFile(void **binary, unsigned long *length);
+extern bool		isMachOInPlace(void * binary, unsigned long length);
 extern long		DecodeMachO(void *binary, entry_t *rentry, char **raddr, int *rsize);
+extern long		indexMachO(void * binary, MachOView * view);
+extern long		lookupSymbols(MachOView * view, SymbolTarget * targets, int targetCount);
 extern long		loadBinaryData(char *aFilePath, void **aMemoryAddress);
 
 
@@ -154,13 +160,47 @@ extern long		loadBinaryData(char *aFilePath, void **aMemoryAddress);
 long			AllocateKernelMemory(long inSize);
 long			AllocateMemoryRange(char * rangeName, long start, long length);
 
+#if DYNAMIC_MEMORY_LAYOUT
+void			planMemoryLayout(struct MemoryRange * rangeArray, unsigned long rangeCount);
+#endif
+
 
 /* platform.c */
 extern void		enableA20(void);
 
 
+/* prefetch.c */
+#if BOOT_IO_TRACE
+	extern void		recordDiskRead(int biosdev, uint64_t sector, uint32_t count);
+	extern bool		readPrefetched(int biosdev, uint64_t sector, uint32_t count, char * buffer);
+	extern void		prefetchBootIOTrace(void);
+	extern void		exportBootIOTrace(void);
+#endif
+
+
+/* profiler.c */
+#if (BOOT_PROFILER || IO_STATISTICS)
+	#define BOOT_PHASE(phase)	recordBootPhase(phase)
+
+	extern void		recordBootPhase(uint32_t phase);
+	extern void		exportBootProfile(void);
+#else
+	#define BOOT_PHASE(phase)
+#endif
+
+#if IO_STATISTICS
+	#define IO_STAT(field, count)	gIOStats[gBootPhase].field += (count)
+
+	extern uint32_t	gBootPhase;
+	extern IOStats	gIOStats[kBootPhaseCount];
+#else
+	#define IO_STAT(field, count)
+#endif
+
+
 /* stringTable.c */
 extern int		base64Decode(char *input, unsigned char **decodedData);
+extern char		* base64Encode(const unsigned char *data, size_t length);
 
 extern bool		getValueForConfigTableKey(config_file_t *config, const char *key, const char **val, int *size);
 extern char		* newStringForKey(char *key, config_file_t *configBuff);
@@ -171,7 +211,7 @@ extern bool		getIntForKey(const char *key, int *val, config_file_t *configBuff);
 extern long		loadConfigFile(const char *configFile, config_file_t *configBuff);
 extern long		loadCABootPlist(void);
 extern char		* getNextArg(char ** ptr, char * val);
-extern long		ParseXMLFile(char * buffer, TagPtr * dict);
+extern long		ParseXMLFileInPlace(char * buffer, TagPtr * dict);
 
 
 /* sys.c */
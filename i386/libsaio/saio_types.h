@@ -62,6 +62,136 @@ typedef struct Tag
 } Tag, *TagPtr;
 
 
+// Used by lookupSymbols() in load.c
+
+typedef struct SymbolTarget
+{
+	const char *	name;			// Symbol name (including the leading underscore).
+	uint8_t			section;		// Required n_sect value (0 matches any section).
+	bool			found;			// Set by lookupSymbols().
+	uint32_t		hash;			// Used internally by lookupSymbols().
+	uint64_t		value;			// n_value of the symbol (when found).
+} SymbolTarget;
+
+
+// Mach-O view, filled by indexMachO() in load.c with a single walk over the load commands.
+
+#define MACHO_MAX_SEGMENTS	16
+#define MACHO_MAX_SECTIONS	64
+
+typedef struct MachOSegment
+{
+	const char *	name;			// Points to segname in the load command.
+	uint64_t		vmaddr;
+	uint64_t		vmsize;
+	uint64_t		fileoff;
+	uint64_t		filesize;
+	uint32_t		firstSection;	// Index in sections[] of the first section (section number - 1).
+	uint32_t		sectionCount;
+} MachOSegment;
+
+typedef struct MachOSection
+{
+	const char *	segmentName;	// Points to segname in the section header.
+	const char *	sectionName;	// Points to sectname in the section header.
+	uint64_t		addr;
+	uint64_t		size;
+} MachOSection;
+
+typedef struct MachOView
+{
+	void *			binary;
+	bool			is64Bit;
+	unsigned long	symtabCmd;		// Address of the LC_SYMTAB command (0 when not available).
+	unsigned long	dysymtabCmd;	// Address of the LC_DYSYMTAB command (0 when not available).
+	unsigned long	entryCmd;		// Address of the LC_UNIXTHREAD or LC_MAIN command (0 when not available).
+	uint32_t		segmentCount;
+	uint32_t		sectionCount;	// Number of (recorded) sections. Section numbers (n_sect) start at 1.
+	MachOSegment	segments[MACHO_MAX_SEGMENTS];
+	MachOSection	sections[MACHO_MAX_SECTIONS];
+} MachOView;
+
+
+// Boot phase profile (see profiler.c). Copied into kernel memory and exported
+// via bootArgs->performanceDataStart and /RevoEFI/boot-phases.
+
+#define BOOT_PROFILE_SIGNATURE	0x46525042	// 'BPRF'
+#define BOOT_PROFILE_ENTRIES	32			// Ring size (oldest entries are overwritten).
+
+enum
+{
+	kBootPhaseNone = 0,
+	kBootPhaseInitPlatform,
+	kBootPhaseInitPartitionChain,
+	kBootPhaseLoadCABootPlist,
+	kBootPhaseLoadKernel,
+	kBootPhaseDecodeKernel,
+	kBootPhaseLoadDrivers,
+	kBootPhaseSetupACPI,
+	kBootPhaseSetupSMBIOS,
+	kBootPhaseFinalize,
+	kBootPhaseCount
+};
+
+typedef struct BootProfileEntry
+{
+	uint64_t		tsc;			// Time stamp counter at the start of the phase.
+	uint32_t		phase;
+	uint32_t		reserved;
+} BootProfileEntry;
+
+typedef struct BootProfile
+{
+	uint32_t			signature;
+	uint32_t			count;			// Total number of recorded entries (may exceed BOOT_PROFILE_ENTRIES).
+	uint64_t			tscFrequency;	// Hz (use it to convert the time stamps).
+	BootProfileEntry	entries[BOOT_PROFILE_ENTRIES];
+} BootProfile;
+
+
+// I/O counters (see profiler.c). One set per boot phase, exported as an array
+// (indexed by phase) via /RevoEFI/io-stats.
+
+typedef struct IOStats
+{
+	uint32_t		biosCalls;			// INT 13h read calls (including retries).
+	uint32_t		sectorsRead;		// Sectors read by successful BIOS calls.
+	uint32_t		retries;			// Failed INT 13h calls retried by biosread() or ebiosread().
+	uint32_t		eccCorrected;		// Reads with ECC corrected data errors.
+	uint32_t		trackCacheHits;		// Biosread() requests served from the track cache.
+	uint32_t		blockCacheHits;		// CacheRead() hits.
+	uint32_t		blockCacheMisses;
+	uint32_t		blockCacheEvicts;
+	uint32_t		btreeNodeReads[2];	// HFS B-tree node reads (catalog, extents).
+	uint32_t		bytesCopied;		// Bytes copied out of the BIOS buffer by readBytes().
+	uint32_t		prefetchHits;		// Biosread() requests served from the prefetched boot I/O trace.
+} IOStats;
+
+
+// Disk reads of a boot (see prefetch.c) exported via /RevoEFI/boot-io-trace
+// (header plus 'count' ranges) and read back from /Extra/BootIOTrace.bin
+
+#define BOOT_IO_TRACE_SIGNATURE		0x32494F42	// 'BIO2' (64-bit sectors).
+#define BOOT_IO_TRACE_RANGES		1024
+
+typedef struct BootIORange
+{
+	uint64_t		sector;				// First (512 byte) sector of a Biosread() track read.
+	uint32_t		count;				// Number of sectors.
+	uint8_t			biosdev;
+	uint8_t			reserved[3];
+} BootIORange;
+
+typedef struct BootIOTrace
+{
+	uint32_t		signature;
+	uint32_t		count;				// Number of ranges.
+	uint32_t		modTime;			// Boot volume modification time (ih->modTime) at record time.
+	uint32_t		partitionOffset;	// Boot volume (part_boff) for which it was recorded.
+	BootIORange		ranges[BOOT_IO_TRACE_RANGES];
+} BootIOTrace;
+
+
 typedef struct
 {
 	char	plist[4096];	// buffer for plist
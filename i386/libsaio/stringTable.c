@@ -261,77 +261,62 @@ bool getValueForKey(const char *key, const char **val, int *size, config_file_t
 
 
 /*==============================================================================
- * ParseXMLFile modifies the input buffer and expects one dictionary in the
- * XML file. Puts the first dictionary it finds in the tag pointer and returns
- * the length on success or 0 on error, in which case it will not modify the
- * dictionary pointer).
+ * ParseXMLFileInPlace modifies the input buffer and expects one dictionary in
+ * the XML file. Puts the first dictionary it finds in the tag pointer and
+ * returns the length on success or 0 on error, in which case it will not modify
+ * the dictionary pointer). Callers that still need the buffer afterwards should
+ * pass a copy.
  */
 
-long ParseXMLFile(char * buffer, TagPtr * dictionaryPtr)
+long ParseXMLFileInPlace(char * buffer, TagPtr * dictionaryPtr)
 {
 	long	length = -1;
 	long	pos = 0;
 	TagPtr	tag;
-	char	*configBuffer = NULL;
 
 	if (buffer)
 	{
-		configBuffer = malloc(strlen(buffer) + 1);
-	
-		if (configBuffer)
+		while (1)
 		{
-			strcpy(configBuffer, buffer);
+			length = XMLParseNextTag(buffer + pos, &tag);
 
-			while (1)
+			if (length == -1)
 			{
-				length = XMLParseNextTag(configBuffer + pos, &tag);
-
-				if (length == -1)
-				{
-					break;
-				}
-
-				pos += length;
-
-				if (tag == 0)
-				{
-					continue;
-				}
-
-				if (tag->type == kTagTypeDict)
-				{
-					break;
-				}
-
-				XMLFreeTag(tag);
+				break;
 			}
 
-			free(configBuffer);
+			pos += length;
 
-			if (length)
+			if (tag == 0)
 			{
-				*dictionaryPtr = tag;
-
-				return length;
+				continue;
 			}
-#if DEBUG_XML_PARSER
-			else
+
+			if (tag->type == kTagTypeDict)
 			{
-				error ("ParseXMLFile: Error parsing plist file\n");
+				break;
 			}
-#endif
+
+			XMLFreeTag(tag);
+		}
+
+		if (length)
+		{
+			*dictionaryPtr = tag;
+
+			return length;
 		}
 #if DEBUG_XML_PARSER
 		else
 		{
-			error ("ParseXMLFile: configBuffer == NULL\n");
+			error ("ParseXMLFileInPlace: Error parsing plist file\n");
 		}
 #endif
 	}
 #if DEBUG_XML_PARSER
 	else
 	{
-		error ("ParseXMLFile: buffer == NULL\n");
+		error ("ParseXMLFileInPlace: buffer == NULL\n");
 	}
 #endif
 
@@ -349,11 +334,25 @@ long loadConfigFile(const char * configFile, config_file_t *config)
 	{
 		// IO_CONFIG_DATA_SIZE is defined as 4096 in bios.h and which should
 		// be sufficient enough for RevoBoot (size was 4K for years already).
-		read(fd, config->plist, IO_CONFIG_DATA_SIZE);
+		// The last byte is reserved for the terminating zero.
+		long length = read(fd, config->plist, IO_CONFIG_DATA_SIZE - 1);
 		close(fd);
-	
-		// Build XML dictionary.
-		if (ParseXMLFile(config->plist, &config->dictionary) > 0)
+
+		config->plist[(length > 0) ? length : 0] = '\0';
+
+#if BINARY_PLIST_SUPPORT
+		if (XMLIsBinaryPlist(config->plist, length))
+		{
+			length = XMLParseBinaryPlist(config->plist, length, &config->dictionary);
+		}
+		else
+#endif
+		{
+			// Build XML dictionary (config->plist is only used as parse buffer).
+			length = ParseXMLFileInPlace(config->plist, &config->dictionary);
+		}
+
+		if (length > 0)
 		{
 			return EFI_SUCCESS;
 		}
@@ -444,8 +443,7 @@ long loadCABootPlist(void)
 #if (APPLE_RAID_SUPPORT || CORE_STORAGE_SUPPORT)
 				if (strncmp(path, "/com.apple.boot.", 16) == 0)
 				{
-					gPlatform.HelperPath = malloc(18);
-					bzero(gPlatform.HelperPath, 18);
+					gPlatform.HelperPath = calloc(1, 18);
 					strncpy(gPlatform.HelperPath, path, 17);
 				}
 #endif
@@ -594,7 +594,7 @@ struct dirstuff * vol_opendir(BVRef bvr, const char * path)
 {
 	struct dirstuff * dirp = 0;
 
-	dirp = (struct dirstuff *) malloc(sizeof(struct dirstuff));
+	dirp = (struct dirstuff *) calloc(1, sizeof(struct dirstuff));
 
 	if (dirp)
 	{
@@ -624,7 +624,7 @@ struct dirstuff * opendir(const char * path)
 
 	if ((bvr = getBootVolumeRef(path, &dirPath)))
 	{
-		dirp = (struct dirstuff *) malloc(sizeof(struct dirstuff));
+		dirp = (struct dirstuff *) calloc(1, sizeof(struct dirstuff));
 
 		if (dirp)
 		{
@@ -898,7 +898,11 @@ static BVRef newBootVolumeRef(int biosdev, int partno)
 
 void initPartitionChain(void)
 {
-	gPlatform.BootPartitionChain = diskScanGPTBootVolumes(gPlatform.BIOSDevice, 0);
+	int count = 0; // diskScanGPTBootVolumes() does not accept a NULL pointer.
+
+	BOOT_PHASE(kBootPhaseInitPartitionChain);
+
+	gPlatform.BootPartitionChain = diskScanGPTBootVolumes(gPlatform.BIOSDevice, &count);
 }
 
 
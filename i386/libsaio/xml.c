@@ -76,13 +76,63 @@ static TagPtr gTagsFree;
 typedef struct Symbol
 {
 	long			refCount;
-	struct Symbol *	next;
+	uint32_t		hash;
+	uint32_t		length;
 	char			string[];
 } Symbol, *SymbolPtr;
 
-static SymbolPtr FindSymbol(char * string, SymbolPtr * prevSymbol);
+/*
+ * Interned strings are kept in an open addressing hash table (linear probing
+ * with backward shift deletion, so no tombstones) that doubles in size when
+ * it gets half full.
+ */
+#define kSymbolTableMinSlots	1024	// Must be a power of two.
+
+static SymbolPtr *	gSymbolTable	= NULL;
+static uint32_t		gSymbolSlots	= 0;
+static uint32_t		gSymbolCount	= 0;
+
+// Statistics (see XMLPrintSymbolStats).
+static uint32_t		gSymbolLookups	= 0;
+static uint32_t		gSymbolProbes	= 0;
+static uint32_t		gSymbolMaxProbe	= 0;
+
+/*
+ * Dictionaries with more than kDictIndexMinKeys keys get a (lazily built) hash
+ * index of their key tags, which is stored in the otherwise unused string
+ * field of the dictionary tag. Smaller dictionaries use the linear walk.
+ *
+ * Dictionaries that are parsed into an arena start with an empty index (zero
+ * slots) that records the arena, so that their index is allocated from the
+ * same arena later on – also when another arena (or none) is set by then.
+ */
+#define kDictIndexMinKeys		8
+
+typedef struct DictIndexEntry
+{
+	uint32_t		hash;
+	TagPtr			key;
+} DictIndexEntry;
+
+typedef struct DictIndex
+{
+	uint32_t		slots;			// Power of two (0 for an empty index).
+	arena_t			* arena;		// Arena of the dictionary (NULL when malloc'd).
+	DictIndexEntry	entries[];
+} DictIndex;
+
+static DictIndex gSmallDictIndex;	// Marks dictionaries that use the linear walk.
+
+static DictIndex * BuildDictIndex(TagPtr dict);
+static char * NewDictIndex(void);
+
+static uint32_t HashSymbol(const char * string, uint32_t * length);
+static uint32_t FindSymbolSlot(const char * string, uint32_t hash, uint32_t length);
+static bool GrowSymbolTable(void);
+
+static arena_t * gXMLArena = NULL; // See XMLSetArena()
 
-static SymbolPtr gSymbolsHead;
+typedef uint32_t __attribute__((may_alias)) scan_word_t; // Used by ScanForChar()
 
 static long ParseTagList(char *buffer, TagPtr *tag, long type, long empty);
 static long ParseTagKey(char *buffer, TagPtr *tag);
@@ -92,12 +142,25 @@ static long ParseTagData(char *buffer, TagPtr *tag);
 static long ParseTagDate(char *buffer, TagPtr *tag);
 static long ParseTagBoolean(char *buffer, TagPtr *tag, long type);
 static long GetNextTag(char *buffer, char **tag, long *start);
+static char *ScanForChar(char *buffer, char c);
 static long FixDataMatchingTag(char *buffer, char *tag);
 static TagPtr NewTag(void);
 static char *NewSymbol(char *string);
 static void FreeSymbol(char *string);
 
 
+//==============================================================================
+// Tags and strings of the documents that are parsed while an arena is set, are
+// allocated from that arena, and released in one go with arena_reset(). Note
+// that XMLFreeTag() skips the tags of the arena that is set, and that it must
+// not be called for these tags after the arena is unset (with NULL).
+
+void XMLSetArena(arena_t * arena)
+{
+	gXMLArena = arena;
+}
+
+
 //==============================================================================
 
 TagPtr XMLGetProperty(TagPtr dict, const char * key)
@@ -106,7 +169,36 @@ TagPtr XMLGetProperty(TagPtr dict, const char * key)
 	{
 		TagPtr tag = 0;
 		TagPtr tagList = dict->tag;
-		
+
+		DictIndex * index = (DictIndex *)dict->string;
+
+		if (index == &gSmallDictIndex)
+		{
+			index = NULL;
+		}
+		else if (index == NULL || index->slots == 0)
+		{
+			index = BuildDictIndex(dict);
+		}
+
+		if (index)
+		{
+			uint32_t length, mask = (index->slots - 1);
+			uint32_t hash = HashSymbol(key, &length);
+			uint32_t slot = (hash & mask);
+
+			for (; (tag = index->entries[slot].key) != NULL; slot = ((slot + 1) & mask))
+			{
+				// Interned key strings can be compared by pointer.
+				if (index->entries[slot].hash == hash && (tag->string == key || !strcmp(tag->string, key)))
+				{
+					return tag->tag;
+				}
+			}
+
+			return 0;
+		}
+
 		while (tagList)
 		{
 			tag = tagList;
@@ -116,7 +208,7 @@ TagPtr XMLGetProperty(TagPtr dict, const char * key)
 			{
 				continue;
 			}
-			else if (!strcmp(tag->string, key))
+			else if (tag->string == key || !strcmp(tag->string, key))
 			{
 				return tag->tag;
 			}
@@ -127,6 +219,108 @@ TagPtr XMLGetProperty(TagPtr dict, const char * key)
 }
 
 
+//==============================================================================
+// Returns the index of a dictionary (built on first use) or NULL for small ones.
+
+static DictIndex * BuildDictIndex(TagPtr dict)
+{
+	uint32_t keyCount = 0, slots = 16, slot, length, hash;
+
+	DictIndex * index = (DictIndex *)dict->string;
+
+	arena_t * arena = index ? index->arena : NULL;
+
+	TagPtr tag;
+
+	for (tag = dict->tag; tag; tag = tag->tagNext)
+	{
+		if (tag->type == kTagTypeKey && tag->string)
+		{
+			keyCount++;
+		}
+	}
+
+	if (keyCount <= kDictIndexMinKeys)
+	{
+		// Skip the key count in later lookups.
+		dict->string = (char *)&gSmallDictIndex;
+		return NULL;
+	}
+
+	// Keep the index at most half full.
+	while (slots < (keyCount * 2))
+	{
+		slots <<= 1;
+	}
+
+	length = sizeof(DictIndex) + (slots * sizeof(DictIndexEntry));
+
+	// Indexes of arena dictionaries go into the arena of the dictionary, so that arena_reset() frees them.
+	if (arena)
+	{
+		index = arena_alloc(arena, length);
+	}
+	else
+	{
+		index = malloc(length);
+	}
+
+	if (index == NULL)
+	{
+		return NULL;
+	}
+
+	bzero(index, length);
+	index->slots = slots;
+	index->arena = arena;
+
+	for (tag = dict->tag; tag; tag = tag->tagNext)
+	{
+		if (tag->type == kTagTypeKey && tag->string)
+		{
+			hash = HashSymbol(tag->string, &length);
+
+			for (slot = (hash & (slots - 1)); index->entries[slot].key; slot = ((slot + 1) & (slots - 1)))
+			{
+				// Duplicated key. The first one wins (like in the linear walk).
+				if (index->entries[slot].hash == hash && !strcmp(index->entries[slot].key->string, tag->string))
+				{
+					break;
+				}
+			}
+
+			if (index->entries[slot].key == NULL)
+			{
+				index->entries[slot].hash = hash;
+				index->entries[slot].key = tag;
+			}
+		}
+	}
+
+	dict->string = (char *)index;
+
+	return index;
+}
+
+
+//==============================================================================
+// Returns the initial string field of a new dictionary tag: an empty index that
+// records the arena in arena mode, or NULL otherwise.
+
+static char * NewDictIndex(void)
+{
+	DictIndex * index = NULL;
+
+	if (gXMLArena && (index = arena_alloc(gXMLArena, sizeof(DictIndex))))
+	{
+		index->slots = 0;
+		index->arena = gXMLArena;
+	}
+
+	return (char *)index;
+}
+
+
 #if UNUSED
 //==========================================================================
 // Expects to see one dictionary in the XML file.
@@ -299,7 +493,7 @@ static long ParseTagList(char * buffer, TagPtr * tag, long type, long empty)
 	}
 
 	tmpTag->type	= type;
-	tmpTag->string	= 0;
+	tmpTag->string	= (type == kTagTypeDict) ? NewDictIndex() : 0;
 	tmpTag->tag		= tagList;
 	tmpTag->tagNext	= 0;
 
@@ -403,10 +597,8 @@ static long ParseTagInteger(char * buffer, TagPtr * tag)
 
 		if (tmpTag)
 		{
-			int integer = 0;
-
 			tmpTag->type	= kTagTypeInteger;
-			tmpTag->string	= (char *)integer;
+			tmpTag->string	= 0; // The value is not stored.
 			tmpTag->tag		= 0;
 			tmpTag->tagNext	= 0;
 
@@ -504,35 +696,25 @@ static long GetNextTag(char * buffer, char ** tag, long * start)
 	if (tag)
 	{
 		// Find the start of the tag.
-		long cnt = 0L;
-
-		while ((buffer[cnt] != '\0') && (buffer[cnt] != '<'))
-		{
-			cnt++;
-		}
+		char * tagStart = ScanForChar(buffer, '<');
 
-		if (buffer[cnt] != '\0')
+		if (*tagStart != '\0')
 		{
 			// Find the end of the tag.
-			long cnt2 = cnt + 1L;
-
-			while ((buffer[cnt2] != '\0') && (buffer[cnt2] != '>'))
-			{
-				cnt2++;
-			}
+			char * tagEnd = ScanForChar(tagStart + 1, '>');
 
-			if (buffer[cnt2] != '\0')
+			if (*tagEnd != '\0')
 			{
 				// Fix the tag data.
-				*tag = buffer + cnt + 1;
-				buffer[cnt2] = '\0';
+				*tag = tagStart + 1;
+				*tagEnd = '\0';
 
 				if (start)
 				{
-					*start = cnt;
+					*start = (tagStart - buffer);
 				}
 
-				return cnt2 + 1;
+				return (tagEnd - buffer) + 1;
 			}
 		}
 	}
@@ -541,6 +723,47 @@ static long GetNextTag(char * buffer, char ** tag, long * start)
 }
 
 
+//==============================================================================
+// Returns a pointer to the first 'c' or '\0' in 'buffer'. Checks four bytes
+// at a time once the pointer is aligned. Aligned loads never cross a page so
+// reading past the terminating zero is safe.
+
+static char * ScanForChar(char * buffer, char c)
+{
+	uint32_t pattern = (uint8_t)c * 0x01010101UL;
+
+	while ((unsigned long)buffer & 3)
+	{
+		if ((*buffer == c) || (*buffer == '\0'))
+		{
+			return buffer;
+		}
+
+		buffer++;
+	}
+
+	while (1)
+	{
+		uint32_t word = *(scan_word_t *)buffer;
+		uint32_t match = word ^ pattern;
+
+		if (((word - 0x01010101UL) & ~word & 0x80808080UL) | ((match - 0x01010101UL) & ~match & 0x80808080UL))
+		{
+			break;
+		}
+
+		buffer += 4;
+	}
+
+	while ((*buffer != c) && (*buffer != '\0'))
+	{
+		buffer++;
+	}
+
+	return buffer;
+}
+
+
 //==============================================================================
 // Modifies 'buffer' to add a '\0' at the end of the tag matching 'tag'.
 // Returns the length of the data found, counting the end tag,
@@ -548,29 +771,31 @@ static long GetNextTag(char * buffer, char ** tag, long * start)
 
 static long FixDataMatchingTag(char * buffer, char * tag)
 {
-	char * endTag;
-
-	long length, stop, start = 0;
+	long tagLength = strlen(tag);
+	char * endTag = buffer;
 
+	// Values (key, string, data etc.) do not nest so we can jump straight to
+	// the next '<' and compare it with "</tag>" without splitting other tags.
 	while (1)
 	{
-		length = GetNextTag(buffer + start, &endTag, &stop);
+		endTag = ScanForChar(endTag, '<');
 
-		if (length == -1)
+		if (*endTag == '\0')
 		{
 			return -1;
 		}
-		else if ((*endTag == '/') && !strcmp(endTag + 1, tag))
+
+		if ((endTag[1] == '/') && !strncmp(endTag + 2, tag, tagLength) && (endTag[tagLength + 2] == '>'))
 		{
 			break;
 		}
 
-		start += length;
+		endTag++;
 	}
 
-	buffer[start + stop] = '\0';
+	*endTag = '\0';
 
-	return start + length;
+	return (endTag - buffer) + tagLength + 3;
 }
 
 
@@ -582,6 +807,11 @@ static TagPtr NewTag(void)
 
 	TagPtr	tag = NULL;
 
+	if (gXMLArena)
+	{
+		return (TagPtr)arena_alloc(gXMLArena, sizeof(Tag));
+	}
+
 	if (gTagsFree == NULL)
 	{
 		tag = (TagPtr)malloc(kTagsPerBlock * sizeof(Tag));
@@ -615,12 +845,48 @@ static TagPtr NewTag(void)
 
 
 //==============================================================================
+// Returns a new tag with a copy of 'string' (when not NULL). Used by the binary
+// plist reader (bplist.c) to build the same tag tree as the XML parser.
 
-void XMLFreeTag(TagPtr tag)
+TagPtr XMLNewTag(long type, char * string)
 {
+	TagPtr tag = NewTag();
+
 	if (tag)
 	{
-		if (tag->string)
+		tag->type		= type;
+		tag->string		= (type == kTagTypeDict) ? NewDictIndex() : (string ? NewSymbol(string) : 0);
+		tag->tag		= 0;
+		tag->tagNext	= 0;
+
+		if (string && tag->string == 0)
+		{
+			XMLFreeTag(tag);
+
+			return NULL;
+		}
+	}
+
+	return tag;
+}
+
+
+//==============================================================================
+
+void XMLFreeTag(TagPtr tag)
+{
+	// Arena tags are released with arena_reset() (malloc'd trees can still be freed).
+	if (tag && (gXMLArena == NULL || !arena_contains(gXMLArena, tag)))
+	{
+		if (tag->type == kTagTypeDict)
+		{
+			// The string field of a dictionary holds its index.
+			if (tag->string && tag->string != (char *)&gSmallDictIndex && ((DictIndex *)tag->string)->arena == NULL)
+			{
+				free(tag->string);
+			}
+		}
+		else if (tag->string)
 		{
 			FreeSymbol(tag->string);
 		}
@@ -638,29 +904,137 @@ void XMLFreeTag(TagPtr tag)
 }
 
 
+//==============================================================================
+// FNV-1a hash. Also returns the length of the string.
+
+static uint32_t HashSymbol(const char * string, uint32_t * length)
+{
+	uint32_t hash = 2166136261UL;
+	const char * start = string;
+
+	for (; *string; string++)
+	{
+		hash = ((hash ^ (uint8_t)*string) * 16777619UL);
+	}
+
+	*length = (string - start);
+
+	return hash;
+}
+
+
+//==============================================================================
+// Returns the slot with the matching symbol, or the (empty) slot to use for it.
+
+static uint32_t FindSymbolSlot(const char * string, uint32_t hash, uint32_t length)
+{
+	uint32_t mask = (gSymbolSlots - 1);
+	uint32_t slot = (hash & mask);
+	uint32_t probes = 1;
+
+	SymbolPtr symbol;
+
+	for (; (symbol = gSymbolTable[slot]) != NULL; slot = ((slot + 1) & mask), probes++)
+	{
+		if (symbol->hash == hash && symbol->length == length && !strcmp(symbol->string, string))
+		{
+			break;
+		}
+	}
+
+	gSymbolLookups++;
+	gSymbolProbes += probes;
+
+	if (probes > gSymbolMaxProbe)
+	{
+		gSymbolMaxProbe = probes;
+	}
+
+	return slot;
+}
+
+
+//==============================================================================
+
+static bool GrowSymbolTable(void)
+{
+	uint32_t index, slot, oldSlots = gSymbolSlots;
+	uint32_t newSlots = oldSlots ? (oldSlots * 2) : kSymbolTableMinSlots;
+
+	SymbolPtr * oldTable = gSymbolTable;
+	SymbolPtr * newTable = calloc(newSlots, sizeof(SymbolPtr));
+
+	if (newTable == NULL)
+	{
+		return false;
+	}
+
+	for (index = 0; index < oldSlots; index++)
+	{
+		if (oldTable[index])
+		{
+			for (slot = (oldTable[index]->hash & (newSlots - 1)); newTable[slot]; slot = ((slot + 1) & (newSlots - 1)));
+
+			newTable[slot] = oldTable[index];
+		}
+	}
+
+	gSymbolTable = newTable;
+	gSymbolSlots = newSlots;
+
+	free(oldTable);
+
+	return true;
+}
+
+
 //==============================================================================
 
 static char * NewSymbol(char * string)
 {
-	static SymbolPtr lastGuy = 0;
+	uint32_t length, slot, hash;
 
-	// Look for string in the list of symbols.
-	SymbolPtr symbol = FindSymbol(string, 0);
+	SymbolPtr symbol;
+
+	// Arena strings are not shared (no lookup and no reference counting).
+	if (gXMLArena)
+	{
+		char * arenaString = arena_alloc(gXMLArena, strlen(string) + 1);
+
+		if (arenaString)
+		{
+			strcpy(arenaString, string);
+		}
+
+		return arenaString;
+	}
+
+	// Keep the table at most half full.
+	if (((gSymbolCount + 1) * 2) > gSymbolSlots && !GrowSymbolTable())
+	{
+		stop ("xml.c");
+	}
+
+	hash = HashSymbol(string, &length);
+	slot = FindSymbolSlot(string, hash, length);
+	symbol = gSymbolTable[slot];
 
 	// Add new symbol.
 	if (symbol == 0)
 	{
-		symbol = (SymbolPtr)malloc(sizeof(Symbol) + 1 + strlen(string));
+		symbol = (SymbolPtr)malloc(sizeof(Symbol) + 1 + length);
 
 		if (symbol)
 		{
 			// Set the symbol's data.
 			symbol->refCount = 0;
+			symbol->hash = hash;
+			symbol->length = length;
 			strcpy(symbol->string, string);
-			
-			// Add the symbol to the list.
-			symbol->next = gSymbolsHead;
-			gSymbolsHead = symbol;
+
+			// Add the symbol to the table.
+			gSymbolTable[slot] = symbol;
+			gSymbolCount++;
 		}
 		else
 		{
@@ -671,11 +1045,6 @@ static char * NewSymbol(char * string)
 	// Update the refCount and return the string.
 	symbol->refCount++;
 
-	if (lastGuy && lastGuy->next != 0)
-	{
-		stop ("xml.c");
-	}
-
 	return symbol->string;
 }
 
@@ -684,11 +1053,19 @@ static char * NewSymbol(char * string)
 
 static void FreeSymbol(char * string)
 {
-	SymbolPtr symbol, prev;
-	prev = 0;
+	uint32_t length, hash, slot, next, home, mask;
 
-	// Look for string in the list of symbols.
-	symbol = FindSymbol(string, &prev);
+	SymbolPtr symbol;
+
+	if (gSymbolTable == NULL)
+	{
+		return;
+	}
+
+	// Look for string in the table of symbols.
+	hash = HashSymbol(string, &length);
+	slot = FindSymbolSlot(string, hash, length);
+	symbol = gSymbolTable[slot];
 
 	if (symbol)
 	{
@@ -697,14 +1074,22 @@ static void FreeSymbol(char * string)
 
 		if (symbol->refCount == 0)
 		{
-			// Remove the symbol from the list.
-			if (prev != 0)
-			{
-				prev->next = symbol->next;
-			}
-			else
+			// Remove the symbol from the table, and move up the entries that probed past it.
+			mask = (gSymbolSlots - 1);
+			gSymbolTable[slot] = NULL;
+			gSymbolCount--;
+
+			for (next = ((slot + 1) & mask); gSymbolTable[next]; next = ((next + 1) & mask))
 			{
-				gSymbolsHead = symbol->next;
+				home = (gSymbolTable[next]->hash & mask);
+
+				// Can the entry move to the empty slot (is the empty slot in between home and next)?
+				if (((next - home) & mask) >= ((next - slot) & mask))
+				{
+					gSymbolTable[slot] = gSymbolTable[next];
+					gSymbolTable[next] = NULL;
+					slot = next;
+				}
 			}
 
 			// Free the symbol's memory.
@@ -715,27 +1100,10 @@ static void FreeSymbol(char * string)
 
 
 //==============================================================================
+// Prints the occupancy and (average/maximum) probe lengths of the symbol table.
 
-static SymbolPtr FindSymbol(char * string, SymbolPtr * prevSymbol)
+void XMLPrintSymbolStats(void)
 {
-	SymbolPtr prev		= 0;
-	SymbolPtr symbol	= gSymbolsHead;
-
-	while (symbol != 0)
-	{
-		if (!strcmp(symbol->string, string))
-		{
-			break;
-		}
-
-		prev = symbol;
-		symbol = symbol->next;
-	}
-
-	if ((symbol != 0) && (prevSymbol != 0))
-	{
-		*prevSymbol = prev;
-	}
-
-	return symbol;
-}
\ No newline at end of file
+	printf("XML symbols: %d in %d slots, %d lookups, %d probes (max %d)\n",
+		   gSymbolCount, gSymbolSlots, gSymbolLookups, gSymbolProbes, gSymbolMaxProbe);
+}
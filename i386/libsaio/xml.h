@@ -63,8 +63,16 @@ extern long  gImageLastKernelAddr;
 
 TagPtr XMLGetProperty(TagPtr dict, const char * key);
 
+TagPtr XMLNewTag(long type, char * string);
+
+void XMLSetArena(arena_t * arena);
+void XMLPrintSymbolStats(void);
 void XMLFreeTag(TagPtr tag);
 long XMLParseFile(char * buffer, TagPtr * dict);
 long XMLParseNextTag(char *buffer, TagPtr *tag);
 
+/* bplist.c */
+bool XMLIsBinaryPlist(const char * buffer, long length);
+long XMLParseBinaryPlist(const char * buffer, long length, TagPtr * dict);
+
 #endif /* __LIBSAIO_XML_H */